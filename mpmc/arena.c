@@ -0,0 +1,175 @@
+/*
+* Reserved Address Space.
+*
+* The whole range is mapped PROT_NONE up front, so it costs address space only.
+* Allocation bumps the 'top' offset and makes the new pages readable and writable:
+*
+*   base                           top                    base + reserved
+*    |                              |                            |
+*    |chunk|chunk|.hole.|chunk|     |......... PROT_NONE ........|
+*
+* The kernel backs committed pages on first touch, so a vector grows into
+* the range without malloc() and without moving what is already there.
+*
+* Freeing the topmost allocation moves 'top' back, so a vector that grows and
+* shrinks repeatedly reuses the same addresses. Anything else leaves a hole:
+* its pages go back to the kernel but the addresses are not handed out again.
+*
+* Pages on the border of an allocation may be shared with its neighbours,
+* so only pages fully inside it are given back.
+*/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "cpu.h"
+#include "debug.h"
+
+// Transparent huge pages are this large on x86-64 and arm64 with 4 KiB pages
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+struct arena_t
+{
+	unsigned char* base;
+	size_t reserved;
+	size_t page_size;
+
+	unsigned char* mapping;	// what mmap() returned, 'base' may be aligned past it
+	size_t mapped;
+
+	atomic_size_t top;		// offset of the first byte not handed out
+};
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+arena_t* arena_create(size_t reserve_bytes, bool huge_pages);
+void arena_destroy(arena_t* arena);
+void* arena_alloc(arena_t* arena, size_t bytes);
+bool arena_free(arena_t* arena, void* memory, size_t bytes);
+bool arena_owns(const arena_t* arena, const void* memory);
+
+static inline size_t arena_round_up(size_t value, size_t align);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+arena_t* arena_create(size_t reserve_bytes, bool huge_pages)
+{
+	arena_t* arena = malloc(sizeof(*arena));
+
+	if (arena == NULL)
+		return NULL;
+
+	arena->page_size = (size_t)sysconf(_SC_PAGESIZE);
+	arena->reserved = arena_round_up(reserve_bytes, huge_pages ? HUGE_PAGE_SIZE : arena->page_size);
+
+	// Huge pages need an aligned range, map a bit more and start at the first boundary
+	size_t slack = huge_pages ? HUGE_PAGE_SIZE : 0;
+
+	if (arena->reserved == 0 || arena->reserved > SIZE_MAX - slack) {
+		free(arena);
+		return NULL;
+	}
+
+	arena->mapped = arena->reserved + slack;
+	arena->mapping = mmap(NULL, arena->mapped, PROT_NONE,
+						  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (arena->mapping == MAP_FAILED) {
+		debug_print("Could not reserve %zu bytes\n", arena->mapped);
+		free(arena);
+		return NULL;
+	}
+
+	arena->base = (unsigned char*)arena_round_up((uintptr_t)arena->mapping, huge_pages ? HUGE_PAGE_SIZE : 1);
+	atomic_init(&arena->top, 0);
+
+	// Only a hint, the kernel may have THP disabled
+	if (huge_pages && madvise(arena->base, arena->reserved, MADV_HUGEPAGE) != 0) {
+		debug_print("Transparent huge pages are not available for %zu bytes\n", arena->reserved);
+	}
+
+	return arena;
+}
+
+void arena_destroy(arena_t* arena)
+{
+	if (arena == NULL)
+		return;
+
+	munmap(arena->mapping, arena->mapped);
+	free(arena);
+}
+
+void* arena_alloc(arena_t* arena, size_t bytes)
+{
+	if (bytes > arena->reserved)
+		return NULL;
+
+	bytes = arena_round_up(bytes, CACHE_LINE_SIZE);
+
+	size_t top = atomic_load_explicit(&arena->top, memory_order_relaxed);
+
+	do {
+		if (arena->reserved - top < bytes)
+			return NULL;
+	} while (!atomic_compare_exchange_weak_explicit(&arena->top, &top, top + bytes,
+													memory_order_relaxed, memory_order_relaxed));
+
+	unsigned char* memory = arena->base + top;
+	uintptr_t first = (uintptr_t)memory & ~(uintptr_t)(arena->page_size - 1);
+	uintptr_t last = arena_round_up((uintptr_t)(memory + bytes), arena->page_size);
+
+	// Committing a page twice is harmless, a neighbour may have done it already
+	if (mprotect((void*)first, last - first, PROT_READ | PROT_WRITE) != 0) {
+		size_t end = top + bytes;
+		atomic_compare_exchange_strong_explicit(&arena->top, &end, top,
+												memory_order_relaxed, memory_order_relaxed);
+		return NULL;
+	}
+
+	return memory;
+}
+
+bool arena_free(arena_t* arena, void* memory, size_t bytes)
+{
+	unsigned char* start = memory;
+
+	if (!arena_owns(arena, memory))
+		return false;
+
+	bytes = arena_round_up(bytes, CACHE_LINE_SIZE);
+
+	uintptr_t first = arena_round_up((uintptr_t)start, arena->page_size);
+	uintptr_t last = (uintptr_t)(start + bytes) & ~(uintptr_t)(arena->page_size - 1);
+
+	// Pages stay committed, they read as zeros and are backed again on the next touch
+	if (first < last)
+		madvise((void*)first, last - first, MADV_DONTNEED);
+
+	size_t end = (size_t)(start - arena->base) + bytes;
+	atomic_compare_exchange_strong_explicit(&arena->top, &end, (size_t)(start - arena->base),
+											memory_order_relaxed, memory_order_relaxed);
+
+	return true;
+}
+
+bool arena_owns(const arena_t* arena, const void* memory)
+{
+	const unsigned char* start = memory;
+
+	return arena != NULL && start >= arena->base && start < arena->base + arena->reserved;
+}
+
+static inline size_t arena_round_up(size_t value, size_t align)
+{
+	return (value + align - 1) / align * align;
+}
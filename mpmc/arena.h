@@ -0,0 +1,64 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+* Reserved address space that vector chunks are carved from,
+* see vector_attr_t 'reserve_bytes'. Pages are committed only when used.
+*/
+typedef struct arena_t arena_t;
+
+/**
+ * Reserve `reserve_bytes` of address space without committing any memory.
+ *
+ * RETURN VALUES:
+ * arena_t pointer
+ * NULL pointer -- when failed to reserve the range
+ *
+ * [in] - reserve_bytes, huge_pages
+ */
+arena_t* arena_create(size_t reserve_bytes, bool huge_pages);
+
+/**
+ * Unmap the whole range. Memory handed out by the arena must not be used anymore.
+ *
+ * [in] - arena
+ */
+void arena_destroy(arena_t* arena);
+
+/**
+ * Commit `bytes` at the top of the arena, aligned to a cache line.
+ *
+ * RETURN VALUES:
+ * pointer to the memory
+ * NULL pointer -- when the reserved range is used up or the pages could not be committed
+ *
+ * [in] - arena, bytes
+ */
+void* arena_alloc(arena_t* arena, size_t bytes);
+
+/**
+ * Give back memory from arena_alloc(), its pages are returned to the kernel.
+ *
+ * RETURN VALUES:
+ * true  -- memory belonged to the arena
+ * false -- memory comes from somewhere else, e.g. malloc()
+ *
+ * [in] - arena, memory, bytes
+ */
+bool arena_free(arena_t* arena, void* memory, size_t bytes);
+
+/**
+ * Check whether memory was handed out by the arena.
+ *
+ * RETURN VALUES:
+ * true  -- memory lies in the reserved range
+ * false -- memory comes from somewhere else, or arena is NULL
+ *
+ * [in] - arena, memory
+ */
+bool arena_owns(const arena_t* arena, const void* memory);
+
+#endif // ARENA_H
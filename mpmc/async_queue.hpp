@@ -0,0 +1,188 @@
+#ifndef MPMC_ASYNC_QUEUE_HPP
+#define MPMC_ASYNC_QUEUE_HPP
+
+#include "queue.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <mutex>
+#include <optional>
+
+/*
+* Coroutine front end of mpmc::queue, C++20.
+*
+* `co_await queue.pop()` suspends the coroutine instead of blocking its thread. Suspended pops wait in
+* a FIFO of awaiters; a push that finds one hands its element straight to it, without going through
+* the vector, and passes the coroutine to the scheduler to be resumed:
+*
+*   push(x) --- waiters? --yes--> awaiter.value = x, scheduler.schedule(awaiter.handle)
+*                   |
+*                   no ---------> vector, then look again for a pop that suspended meanwhile
+*
+* A pop registers in 'waiting' before its last look at the vector, a push looks at 'waiting' after
+* its element is in the vector, both with a full fence between, so either the pop sees the element or
+* the push sees the pop.
+*
+* The Scheduler is any type with `void schedule(std::coroutine_handle<>)`. It is called outside every lock
+* and may resume the coroutine right away, see inline_scheduler, or queue it for one of its threads.
+*/
+namespace mpmc
+{
+	// Resume the awaiter on the pushing thread, inside push()
+	struct inline_scheduler
+	{
+		void schedule(std::coroutine_handle<> handle) { handle.resume(); }
+	};
+
+	template <typename T, typename Scheduler = inline_scheduler>
+	class async_queue
+	{
+	public:
+		using value_type = T;
+
+		class pop_awaiter
+		{
+		public:
+			explicit pop_awaiter(async_queue& queue) noexcept : queue_(queue) {}
+
+			bool await_ready()
+			{
+				value_ = queue_.queue_.try_pop();
+				return value_.has_value();
+			}
+
+			bool await_suspend(std::coroutine_handle<> handle) { return queue_.suspend(*this, handle); }
+
+			T await_resume() { return std::move(*value_); }
+
+		private:
+			friend class async_queue;
+
+			async_queue& queue_;
+			std::optional<T> value_;
+			std::coroutine_handle<> handle_;
+			pop_awaiter* next_ = nullptr;
+		};
+
+		/**
+		 * Create the queue, suspended pops are resumed through `scheduler`, which must outlive it.
+		 * `capacity` and `attr` are passed on to mpmc::queue.
+		 *
+		 * Throws std::bad_alloc when the vector cannot be created.
+		 */
+		explicit async_queue(Scheduler& scheduler, std::size_t capacity = 0, vector_attr_t attr = {})
+			: queue_(capacity, attr), scheduler_(scheduler)
+		{
+		}
+
+		// No pop may be suspended anymore, elements still queued are destroyed
+		~async_queue() = default;
+
+		async_queue(const async_queue&) = delete;
+		async_queue& operator=(const async_queue&) = delete;
+
+		void push(const T& value) { emplace(value); }
+		void push(T&& value) { emplace(std::move(value)); }
+
+		/**
+		 * Construct an element from `args`, in the oldest suspended pop if there is one, at the tail otherwise.
+		 *
+		 * Throws std::bad_alloc when the vector cannot grow, or what the constructor of T throws.
+		 */
+		template <typename... Args>
+		void emplace(Args&&... args)
+		{
+			if (waiting_.load(std::memory_order_seq_cst) > 0) {
+				if (pop_awaiter* awaiter = take_waiter()) {
+					awaiter->value_.emplace(std::forward<Args>(args)...);
+					scheduler_.schedule(awaiter->handle_);
+					return;
+				}
+			}
+
+			queue_.emplace(std::forward<Args>(args)...);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiting_.load(std::memory_order_relaxed) > 0)
+				hand_over();
+		}
+
+		// Awaitable removing the head element, the coroutine is suspended while the queue is empty
+		pop_awaiter pop() noexcept { return pop_awaiter(*this); }
+
+		// Remove the head element, nothing when the queue is empty
+		std::optional<T> try_pop() { return queue_.try_pop(); }
+
+		vector_t* native_handle() const noexcept { return queue_.native_handle(); }
+
+	private:
+		// Register the awaiter, false when an element arrived meanwhile and the coroutine goes on
+		bool suspend(pop_awaiter& awaiter, std::coroutine_handle<> handle)
+		{
+			std::lock_guard<std::mutex> guard(waiters_lock_);
+
+			waiting_.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if ((awaiter.value_ = queue_.try_pop())) {
+				waiting_.fetch_sub(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			awaiter.handle_ = handle;
+			awaiter.next_ = nullptr;
+			(waiters_tail_ ? waiters_tail_->next_ : waiters_head_) = &awaiter;
+			waiters_tail_ = &awaiter;
+
+			return true;
+		}
+
+		pop_awaiter* take_waiter()
+		{
+			std::lock_guard<std::mutex> guard(waiters_lock_);
+
+			return unlink_head();
+		}
+
+		// An element went to the vector while a pop was suspending, give the oldest awaiter the head element
+		void hand_over()
+		{
+			pop_awaiter* awaiter;
+			{
+				std::lock_guard<std::mutex> guard(waiters_lock_);
+
+				if (waiters_head_ == nullptr || !(waiters_head_->value_ = queue_.try_pop()))
+					return;
+
+				awaiter = unlink_head();
+			}
+
+			scheduler_.schedule(awaiter->handle_);
+		}
+
+		// Called under 'waiters_lock_'
+		pop_awaiter* unlink_head()
+		{
+			pop_awaiter* awaiter = waiters_head_;
+
+			if (awaiter != nullptr) {
+				if ((waiters_head_ = awaiter->next_) == nullptr)
+					waiters_tail_ = nullptr;
+
+				waiting_.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+			return awaiter;
+		}
+
+		queue<T> queue_;
+		Scheduler& scheduler_;
+
+		std::mutex waiters_lock_;
+		pop_awaiter* waiters_head_ = nullptr;
+		pop_awaiter* waiters_tail_ = nullptr;
+		std::atomic<std::size_t> waiting_{ 0 };	// awaiters in the list, read without the lock
+	};
+} // namespace mpmc
+
+#endif // MPMC_ASYNC_QUEUE_HPP
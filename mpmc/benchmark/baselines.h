@@ -0,0 +1,375 @@
+#ifndef BASELINES_H
+#define BASELINES_H
+
+extern "C"
+{
+#include "../vector.h"
+#include "../cpu.h"
+}
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Reference queue designs the vector is measured against.
+* They all share one shape: blocking push(uint64_t) / pop(uint64_t&), constructed with a capacity hint,
+* so the same harness drives every one of them. Where a design has no way to block,
+* the caller spins with a yield, which is what a user of that design would have to write.
+*/
+namespace baseline
+{
+
+  // The queue under test, wrapped to the common shape
+  class VectorQueue
+  {
+  public:
+    explicit VectorQueue(size_t capacity) : vector_(vector_create(capacity))
+    {
+      if (vector_ == nullptr)
+      {
+        abort();
+      }
+    }
+
+    ~VectorQueue() { vector_destroy(vector_); }
+
+    void push(uint64_t value)
+    {
+      if (vector_push(vector_, (void *)(uintptr_t)value) != VECTOR_SUCCESS)
+      {
+        abort();
+      }
+    }
+
+    void pop(uint64_t &value)
+    {
+      void *element = nullptr;
+
+      if (vector_pop(vector_, &element) != VECTOR_SUCCESS)
+      {
+        abort();
+      }
+      value = (uint64_t)(uintptr_t)element;
+    }
+
+  private:
+    vector_t *vector_;
+  };
+
+  // std::mutex + std::deque, unbounded, consumers poll
+  class MutexDeque
+  {
+  public:
+    explicit MutexDeque(size_t) {}
+
+    void push(uint64_t value)
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      deque_.push_back(value);
+    }
+
+    void pop(uint64_t &value)
+    {
+      for (;;)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!deque_.empty())
+          {
+            value = deque_.front();
+            deque_.pop_front();
+            return;
+          }
+        }
+        std::this_thread::yield();
+      }
+    }
+
+  private:
+    std::mutex mutex_;
+    std::deque<uint64_t> deque_;
+  };
+
+  // std::mutex + std::condition_variable over a fixed ring, both sides block
+  class CondvarRing
+  {
+  public:
+    explicit CondvarRing(size_t capacity) : ring_(capacity ? capacity : 1) {}
+
+    void push(uint64_t value)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_full_.wait(lock, [this]
+                     { return count_ < ring_.size(); });
+      ring_[(head_ + count_) % ring_.size()] = value;
+      count_++;
+      lock.unlock();
+      not_empty_.notify_one();
+    }
+
+    void pop(uint64_t &value)
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      not_empty_.wait(lock, [this]
+                      { return count_ > 0; });
+      value = ring_[head_];
+      head_ = (head_ + 1) % ring_.size();
+      count_--;
+      lock.unlock();
+      not_full_.notify_one();
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::vector<uint64_t> ring_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+  };
+
+  /*
+  * Dmitry Vyukov's bounded MPMC ring: every cell carries a sequence number,
+  * a thread owns a cell once it wins the CAS on the position counter.
+  */
+  class VyukovRing
+  {
+  public:
+    explicit VyukovRing(size_t capacity)
+    {
+      size_t size = 2;
+
+      while (size < capacity)
+      {
+        size <<= 1;
+      }
+
+      mask_ = size - 1;
+      cells_ = std::vector<Cell>(size);
+      for (size_t i = 0; i < size; i++)
+      {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    void push(uint64_t value)
+    {
+      while (!try_push(value))
+      {
+        std::this_thread::yield();
+      }
+    }
+
+    void pop(uint64_t &value)
+    {
+      while (!try_pop(value))
+      {
+        std::this_thread::yield();
+      }
+    }
+
+  private:
+    struct alignas(CACHE_LINE_SIZE) Cell
+    {
+      std::atomic<size_t> sequence;
+      uint64_t value;
+
+      Cell() = default;
+      Cell(Cell &&) noexcept {}
+      Cell &operator=(Cell &&) noexcept { return *this; }
+    };
+
+    bool try_push(uint64_t value)
+    {
+      size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+      for (;;)
+      {
+        Cell &cell = cells_[pos & mask_];
+        intptr_t diff = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+          if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            cell.value = value;
+            cell.sequence.store(pos + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0)
+        {
+          return false; // full
+        }
+        else
+        {
+          pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    bool try_pop(uint64_t &value)
+    {
+      size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+      for (;;)
+      {
+        Cell &cell = cells_[pos & mask_];
+        intptr_t diff = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+          if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          {
+            value = cell.value;
+            cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (diff < 0)
+        {
+          return false; // empty
+        }
+        else
+        {
+          pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    std::vector<Cell> cells_;
+    size_t mask_ = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_{0};
+  };
+
+  /*
+  * Michael-Scott lock-free linked list queue.
+  * Memory reclamation is the hard part of this design and is out of scope for a baseline:
+  * dequeued dummies are parked on a retired list and freed with the queue,
+  * so nodes are never reused and there is no ABA to guard against.
+  */
+  class MichaelScott
+  {
+  public:
+    explicit MichaelScott(size_t)
+    {
+      Node *dummy = new Node();
+      head_.store(dummy, std::memory_order_relaxed);
+      tail_.store(dummy, std::memory_order_relaxed);
+    }
+
+    ~MichaelScott()
+    {
+      for (Node *node = head_.load(std::memory_order_relaxed); node != nullptr;)
+      {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+
+      for (Node *node = retired_.load(std::memory_order_relaxed); node != nullptr;)
+      {
+        Node *next = node->retired_next;
+        delete node;
+        node = next;
+      }
+    }
+
+    void push(uint64_t value)
+    {
+      Node *node = new Node();
+      node->value = value;
+
+      for (;;)
+      {
+        Node *tail = tail_.load(std::memory_order_acquire);
+        Node *next = tail->next.load(std::memory_order_acquire);
+
+        if (tail != tail_.load(std::memory_order_acquire))
+        {
+          continue;
+        }
+
+        if (next != nullptr)
+        {
+          // tail is lagging, help it along
+          tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+          continue;
+        }
+
+        if (tail->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+          tail_.compare_exchange_strong(tail, node, std::memory_order_release, std::memory_order_relaxed);
+          return;
+        }
+      }
+    }
+
+    void pop(uint64_t &value)
+    {
+      for (;;)
+      {
+        Node *head = head_.load(std::memory_order_acquire);
+        Node *tail = tail_.load(std::memory_order_acquire);
+        Node *next = head->next.load(std::memory_order_acquire);
+
+        if (head != head_.load(std::memory_order_acquire))
+        {
+          continue;
+        }
+
+        if (next == nullptr)
+        {
+          std::this_thread::yield(); // empty
+          continue;
+        }
+
+        if (head == tail)
+        {
+          tail_.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+          continue;
+        }
+
+        value = next->value;
+        if (head_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+          retire(head);
+          return;
+        }
+      }
+    }
+
+  private:
+    struct Node
+    {
+      std::atomic<Node *> next{nullptr};
+      Node *retired_next = nullptr; // a stale thread may still follow `next`, so it is never rewritten
+      uint64_t value = 0;
+    };
+
+    // Treiber push only, the list is walked once no thread uses the queue
+    void retire(Node *node)
+    {
+      Node *top = retired_.load(std::memory_order_relaxed);
+
+      do
+      {
+        node->retired_next = top;
+      } while (!retired_.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<Node *> head_{nullptr};
+    alignas(CACHE_LINE_SIZE) std::atomic<Node *> tail_{nullptr};
+    alignas(CACHE_LINE_SIZE) std::atomic<Node *> retired_{nullptr};
+  };
+
+} // namespace baseline
+
+#endif // BASELINES_H
@@ -1,30 +1,45 @@
 extern "C"
 {
 #include "../vector.h"
+#include "../sharded.h"
 }
 
+#include "../async_queue.hpp"
+
+#include "baselines.h"
+#include "perf_counters.h"
+#include "schedulers.h"
+#include "workload.h"
+
 #include <benchmark/benchmark.h>
 #include <thread>
 #include <iostream>
 #include <fstream>
 #include <chrono>
 #include <string>
+#include <ctime>
+#include <vector>
+#include <atomic>
+#include <cstdlib>
 
 #define LOG_ENABLED 0
 #define BARRIER_ENABLED 1
 
+void spsc_simulate(size_t vector_size, size_t data_amount, const vector_attr_t *attr = nullptr)
+{
+  vector_t *vector = vector_create_attr(vector_size, attr);
+
 #if BARRIER_ENABLED == 1
-pthread_barrier_t thread_ready;
+  // Both threads start pushing and popping at the same time
+  pthread_barrier_t barrier;
+  pthread_barrier_t *thread_ready = &barrier;
+  pthread_barrier_init(thread_ready, NULL, 2);
 #endif
 
-void spsc_simulate(size_t vector_size, size_t data_amount)
-{
-  vector_t *vector = vector_create(vector_size);
-
   auto producer = std::thread([=]()
                               {
 #if BARRIER_ENABLED == 1
-                                pthread_barrier_wait(&thread_ready);
+                                pthread_barrier_wait(thread_ready);
 #endif
                                 vector_ret_t ret = VECTOR_SUCCESS;
                                 size_t iter = 0;
@@ -68,7 +83,7 @@ void spsc_simulate(size_t vector_size, size_t data_amount)
   auto consumer = std::thread([=]()
                               {
 #if BARRIER_ENABLED == 1
-                                pthread_barrier_wait(&thread_ready);
+                                pthread_barrier_wait(thread_ready);
 #endif
                                 vector_ret_t ret = VECTOR_SUCCESS;
                                 void *data_ptr = nullptr;
@@ -114,21 +129,1008 @@ void spsc_simulate(size_t vector_size, size_t data_amount)
   producer.join();
   consumer.join();
 
+#if BARRIER_ENABLED == 1
+  pthread_barrier_destroy(thread_ready);
+#endif
+
   vector_destroy(vector);
 }
 
 static void Bench_spsc_simulate(benchmark::State &state)
 {
-#if BARRIER_ENABLED == 1
-  pthread_barrier_init(&thread_ready, NULL, 2);
-#endif
+  PerfCounters perf;
 
   for (auto _ : state)
   {
+    perf.start();
     spsc_simulate(1000, state.range(0));
+    perf.stop();
   }
+
+  perf.report(state, state.iterations() * state.range(0));
 }
 
 BENCHMARK(Bench_spsc_simulate)->RangeMultiplier(2)->Range(1, 1 << 20);
 
+/*
+* Same pipeline in every vector mode, VECTOR_MODE_SPSC is made for exactly this shape
+*/
+static void Bench_spsc_mode(benchmark::State &state)
+{
+  vector_attr_t attr = {};
+  attr.mode = (vector_mode_t)state.range(1);
+
+  for (auto _ : state)
+  {
+    spsc_simulate(1000, state.range(0), &attr);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(Bench_spsc_mode)
+    ->ArgNames({"items", "mode"})
+    ->ArgsProduct({{1 << 10, 1 << 16, 1 << 20},
+                   {VECTOR_MODE_LOCKED, VECTOR_MODE_LOCKFREE, VECTOR_MODE_TWO_LOCK, VECTOR_MODE_SPSC}})
+    ->UseRealTime();
+
+static void Bench_spsc_wait_strategy(benchmark::State &state)
+{
+  vector_attr_t attr = {};
+  attr.wait = (vector_wait_t)state.range(1);
+
+  for (auto _ : state)
+  {
+    spsc_simulate(1000, state.range(0), &attr);
+  }
+}
+
+BENCHMARK(Bench_spsc_wait_strategy)
+    ->ArgNames({"items", "wait"})
+    ->ArgsProduct({{1 << 10, 1 << 16}, {VECTOR_WAIT_PARK, VECTOR_WAIT_SPIN, VECTOR_WAIT_YIELD, VECTOR_WAIT_ADAPTIVE}});
+
+/*
+* `producers` threads push and `consumers` threads pop `data_amount` records of `payload` bytes,
+* `batch` records per call. Records are split evenly, so every thread knows when it is done.
+*/
+void mpmc_simulate(size_t producers, size_t consumers, size_t vector_size, size_t payload, size_t batch,
+                   size_t data_amount, vector_mode_t mode = VECTOR_MODE_LOCKED, vector_lock_t lock = VECTOR_LOCK_MUTEX)
+{
+  vector_attr_t attr = {};
+  attr.element_size = payload;
+  attr.mode = mode;
+  attr.lock = lock;
+
+  vector_t *vector = vector_create_attr(vector_size, &attr);
+
+  if (vector == nullptr)
+  {
+    abort();
+  }
+
+#if BARRIER_ENABLED == 1
+  pthread_barrier_t barrier;
+  pthread_barrier_t *thread_ready = &barrier;
+  pthread_barrier_init(thread_ready, NULL, producers + consumers);
+#endif
+
+  std::vector<std::thread> threads;
+
+  for (size_t thread_n = 0; thread_n < producers; thread_n++)
+  {
+    threads.emplace_back([=]()
+                         {
+                           std::vector<unsigned char> records(payload * batch, (unsigned char)thread_n);
+#if BARRIER_ENABLED == 1
+                           pthread_barrier_wait(thread_ready);
+#endif
+                           for (size_t iter = 0; iter < data_amount / producers; iter += batch)
+                           {
+                             size_t n = std::min(batch, data_amount / producers - iter);
+                             vector_ret_t ret = (n == 1) ? vector_push_copy(vector, records.data())
+                                                         : vector_push_n_copy(vector, records.data(), n);
+                             if (ret != VECTOR_SUCCESS)
+                             {
+                               abort();
+                             }
+                           }
+                         });
+  }
+
+  for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+  {
+    threads.emplace_back([=]()
+                         {
+                           std::vector<unsigned char> records(payload * batch);
+                           size_t popped = 0;
+#if BARRIER_ENABLED == 1
+                           pthread_barrier_wait(thread_ready);
+#endif
+                           for (size_t iter = 0; iter < data_amount / consumers; iter += popped)
+                           {
+                             size_t n = std::min(batch, data_amount / consumers - iter);
+                             vector_ret_t ret = VECTOR_SUCCESS;
+
+                             if (n == 1)
+                             {
+                               ret = vector_pop_copy(vector, records.data());
+                               popped = 1;
+                             }
+                             else
+                             {
+                               ret = vector_pop_n_copy(vector, records.data(), n, &popped);
+                             }
+
+                             if (ret != VECTOR_SUCCESS)
+                             {
+                               abort();
+                             }
+                           }
+                         });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+#if BARRIER_ENABLED == 1
+  pthread_barrier_destroy(thread_ready);
+#endif
+
+  vector_destroy(vector);
+}
+
+/*
+* Producers x consumers x initial capacity x payload x batch.
+* Capacity 0 starts from a single cell, so the run includes every expansion.
+*/
+static void Bench_mpmc_matrix(benchmark::State &state)
+{
+  const size_t producers = state.range(0);
+  const size_t consumers = state.range(1);
+  const size_t capacity = state.range(2);
+  const size_t payload = state.range(3);
+  const size_t batch = state.range(4);
+  const size_t data_amount = 1 << 18;
+
+  PerfCounters perf;
+
+  for (auto _ : state)
+  {
+    perf.start();
+    mpmc_simulate(producers, consumers, capacity, payload, batch, data_amount);
+    perf.stop();
+  }
+
+  perf.report(state, state.iterations() * data_amount);
+
+  state.counters["items_per_second"] = benchmark::Counter((double)(state.iterations() * data_amount),
+                                                          benchmark::Counter::kIsRate);
+  state.counters["bytes_per_second"] = benchmark::Counter((double)(state.iterations() * data_amount * payload),
+                                                          benchmark::Counter::kIsRate,
+                                                          benchmark::Counter::OneK::kIs1024);
+}
+
+BENCHMARK(Bench_mpmc_matrix)
+    ->ArgNames({"producers", "consumers", "capacity", "payload", "batch"})
+    ->ArgsProduct({{1, 2, 4, 8}, {1, 2, 4, 8}, {0, 1024}, {8, 64, 512}, {1, 32}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* The matrix workload under every lock backend, single records and batches
+*/
+static void Bench_lock_backend(benchmark::State &state)
+{
+  const vector_mode_t mode = (vector_mode_t)state.range(0);
+  const vector_lock_t lock = (vector_lock_t)state.range(1);
+  const size_t threads = state.range(2);
+  const size_t batch = state.range(3);
+  const size_t data_amount = 1 << 18;
+
+  PerfCounters perf;
+
+  for (auto _ : state)
+  {
+    perf.start();
+    mpmc_simulate(threads, threads, 1024, sizeof(void *), batch, data_amount, mode, lock);
+    perf.stop();
+  }
+
+  perf.report(state, state.iterations() * data_amount);
+  state.counters["items_per_second"] = benchmark::Counter((double)(state.iterations() * data_amount),
+                                                          benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(Bench_lock_backend)
+    ->ArgNames({"mode", "lock", "threads", "batch"})
+    ->ArgsProduct({{VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK},
+                   {VECTOR_LOCK_MUTEX, VECTOR_LOCK_ADAPTIVE, VECTOR_LOCK_TTAS, VECTOR_LOCK_TICKET, VECTOR_LOCK_MCS},
+                   {1, 2, 4},
+                   {1, 32}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* Near-empty vector hammered by equal numbers of producers and consumers, with and without elimination.
+* 'eliminated' is the share of elements that never touched the ring.
+*/
+static void Bench_elimination(benchmark::State &state)
+{
+  const size_t threads = state.range(1);
+  const size_t data_amount = 1 << 18;
+
+  vector_attr_t attr = {};
+  attr.mode = (vector_mode_t)state.range(0);
+  attr.elimination = state.range(2);
+  attr.wait = VECTOR_WAIT_YIELD;
+
+  vector_stats_t stats = {};
+  size_t eliminated = 0;
+  size_t contended = 0;
+  size_t pushes = 0;
+
+  for (auto _ : state)
+  {
+    vector_t *vector = vector_create_attr(1024, &attr);
+    std::vector<std::thread> workers;
+
+    for (size_t thread_n = 0; thread_n < threads; thread_n++)
+    {
+      workers.emplace_back([=]()
+                           {
+                             for (size_t iter = 0; iter < data_amount / threads; iter++)
+                             {
+                               if (vector_push(vector, (void *)iter) != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                             } });
+      workers.emplace_back([=]()
+                           {
+                             void *data_ptr = nullptr;
+
+                             for (size_t iter = 0; iter < data_amount / threads; iter++)
+                             {
+                               if (vector_pop(vector, &data_ptr) != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                             } });
+    }
+
+    for (auto &worker : workers)
+    {
+      worker.join();
+    }
+
+    if (vector_stats(vector, &stats) == VECTOR_SUCCESS)
+    {
+      eliminated += stats.eliminated;
+      contended += stats.lock_contended;
+      pushes += stats.pushes;
+    }
+    vector_destroy(vector);
+  }
+
+  state.counters["items_per_second"] = benchmark::Counter((double)(state.iterations() * data_amount),
+                                                          benchmark::Counter::kIsRate);
+  state.counters["eliminated"] = pushes ? (double)eliminated / pushes : 0;
+  state.counters["contended"] = pushes ? (double)contended / pushes : 0; // both sides' locks, per push
+}
+
+BENCHMARK(Bench_elimination)
+    ->ArgNames({"mode", "threads", "elimination"})
+    ->ArgsProduct({{VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK}, {1, 2, 4, 8}, {0, 1}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* The spsc_simulate pipeline generalised over the queue type, so vector_t and the reference designs
+* in baselines.h are timed by exactly the same code.
+*/
+template <typename Queue>
+void baseline_simulate(size_t producers, size_t consumers, size_t capacity, size_t data_amount)
+{
+  Queue queue(capacity);
+
+#if BARRIER_ENABLED == 1
+  pthread_barrier_t barrier;
+  pthread_barrier_t *thread_ready = &barrier;
+  pthread_barrier_init(thread_ready, NULL, producers + consumers);
+#endif
+
+  std::vector<std::thread> threads;
+
+  for (size_t thread_n = 0; thread_n < producers; thread_n++)
+  {
+    threads.emplace_back([=, &queue]()
+                         {
+#if BARRIER_ENABLED == 1
+                           pthread_barrier_wait(thread_ready);
+#endif
+                           for (size_t iter = 0; iter < data_amount / producers; iter++)
+                           {
+                             queue.push(iter);
+                           }
+                         });
+  }
+
+  for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+  {
+    threads.emplace_back([=, &queue]()
+                         {
+                           uint64_t data = 0;
+#if BARRIER_ENABLED == 1
+                           pthread_barrier_wait(thread_ready);
+#endif
+                           for (size_t iter = 0; iter < data_amount / consumers; iter++)
+                           {
+                             queue.pop(data);
+                           }
+                           benchmark::DoNotOptimize(data);
+                         });
+  }
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+#if BARRIER_ENABLED == 1
+  pthread_barrier_destroy(thread_ready);
+#endif
+}
+
+/*
+* vector_t next to the reference designs, one report: the queue is the template argument,
+* the arguments are the thread counts and the capacity handed to the bounded rings.
+*/
+template <typename Queue>
+static void Bench_baseline(benchmark::State &state)
+{
+  const size_t data_amount = 1 << 18;
+
+  PerfCounters perf;
+
+  for (auto _ : state)
+  {
+    perf.start();
+    baseline_simulate<Queue>(state.range(0), state.range(1), state.range(2), data_amount);
+    perf.stop();
+  }
+
+  perf.report(state, state.iterations() * data_amount);
+
+  state.counters["items_per_second"] = benchmark::Counter((double)(state.iterations() * data_amount),
+                                                          benchmark::Counter::kIsRate);
+}
+
+#define BASELINE_ARGS                                                 \
+  ArgNames({"producers", "consumers", "capacity"})                    \
+      ->ArgsProduct({{1, 2, 4}, {1, 2, 4}, {1024}})                   \
+      ->UseRealTime()                                                 \
+      ->Unit(benchmark::kMillisecond)
+
+BENCHMARK_TEMPLATE(Bench_baseline, baseline::VectorQueue)->BASELINE_ARGS;
+BENCHMARK_TEMPLATE(Bench_baseline, baseline::MutexDeque)->BASELINE_ARGS;
+BENCHMARK_TEMPLATE(Bench_baseline, baseline::CondvarRing)->BASELINE_ARGS;
+BENCHMARK_TEMPLATE(Bench_baseline, baseline::VyukovRing)->BASELINE_ARGS;
+BENCHMARK_TEMPLATE(Bench_baseline, baseline::MichaelScott)->BASELINE_ARGS;
+
+static inline uint64_t process_cpu_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline uint64_t monotonic_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+* Wake-up latency and CPU cost of a wait strategy.
+* Producer pushes a timestamp every 20us, so the consumer mostly finds
+* the vector EMPTY and has to wait for every element.
+* 'cpu_load' is process CPU time over wall time, 1.0 means one core fully busy.
+*/
+static void Bench_wait_latency(benchmark::State &state)
+{
+  const size_t data_amount = 1000;
+  const auto gap = std::chrono::microseconds(20);
+
+  vector_attr_t attr = {};
+  attr.mode = (vector_mode_t)state.range(0);
+  attr.wait = (vector_wait_t)state.range(1);
+
+  uint64_t latency_sum = 0;
+  uint64_t latency_max = 0;
+  uint64_t latency_n = 0;
+  uint64_t cpu_ns = 0;
+  uint64_t wall_ns = 0;
+
+  for (auto _ : state)
+  {
+    vector_t *vector = vector_create_attr(16, &attr);
+
+    uint64_t cpu_start = process_cpu_ns();
+    uint64_t wall_start = monotonic_ns();
+
+    auto consumer = std::thread([&]()
+                                {
+                                  void *data_ptr = nullptr;
+
+                                  for (size_t iter = 0; iter < data_amount; iter++)
+                                  {
+                                    if (vector_pop(vector, &data_ptr) == VECTOR_FAILURE)
+                                    {
+                                      abort();
+                                    }
+
+                                    uint64_t latency = monotonic_ns() - (uint64_t)data_ptr;
+                                    latency_sum += latency;
+                                    latency_max = std::max(latency_max, latency);
+                                    latency_n++;
+                                  }
+                                });
+
+    for (size_t iter = 0; iter < data_amount; iter++)
+    {
+      std::this_thread::sleep_for(gap);
+
+      if (vector_push(vector, (void *)monotonic_ns()) == VECTOR_FAILURE)
+      {
+        abort();
+      }
+    }
+
+    consumer.join();
+
+    cpu_ns += process_cpu_ns() - cpu_start;
+    wall_ns += monotonic_ns() - wall_start;
+
+    vector_destroy(vector);
+  }
+
+  state.counters["latency_avg_ns"] = latency_n ? (double)latency_sum / latency_n : 0;
+  state.counters["latency_max_ns"] = (double)latency_max;
+  state.counters["cpu_load"] = wall_ns ? (double)cpu_ns / wall_ns : 0;
+}
+
+BENCHMARK(Bench_wait_latency)
+    ->ArgNames({"mode", "wait"})
+    ->ArgsProduct({{VECTOR_MODE_LOCKED, VECTOR_MODE_LOCKFREE, VECTOR_MODE_TWO_LOCK, VECTOR_MODE_SPSC},
+                   {VECTOR_WAIT_PARK, VECTOR_WAIT_SPIN, VECTOR_WAIT_YIELD, VECTOR_WAIT_ADAPTIVE}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* Scaling with the number of threads: as many producers as consumers,
+* all pushing and popping one shared queue, plain or sharded per CPU.
+*/
+static void Bench_sharded_scaling(benchmark::State &state)
+{
+  const size_t threads = state.range(0);
+  const bool use_shards = state.range(1) != 0;
+  const size_t per_thread = (1 << 20) / threads;
+
+  for (auto _ : state)
+  {
+    vector_t *vector = use_shards ? nullptr : vector_create(1000);
+    sharded_t *sharded = use_shards ? sharded_create(0, 1000, nullptr) : nullptr;
+
+    std::vector<std::thread> workers;
+
+    for (size_t thread_n = 0; thread_n < threads; thread_n++)
+    {
+      workers.emplace_back([=]()
+                           {
+                             for (size_t iter = 0; iter < per_thread; iter++)
+                             {
+                               vector_ret_t ret = use_shards ? sharded_push(sharded, (void *)iter)
+                                                             : vector_push(vector, (void *)iter);
+                               if (ret != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                             }
+                           });
+
+      workers.emplace_back([=]()
+                           {
+                             void *data_ptr = nullptr;
+
+                             for (size_t iter = 0; iter < per_thread; iter++)
+                             {
+                               vector_ret_t ret = use_shards ? sharded_pop(sharded, &data_ptr)
+                                                             : vector_pop(vector, &data_ptr);
+                               if (ret != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                             }
+                           });
+    }
+
+    for (auto &worker : workers)
+    {
+      worker.join();
+    }
+
+    if (use_shards)
+    {
+      sharded_destroy(sharded);
+    }
+    else
+    {
+      vector_destroy(vector);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * per_thread * threads);
+}
+
+BENCHMARK(Bench_sharded_scaling)
+    ->ArgNames({"threads", "sharded"})
+    ->ArgsProduct({{1, 2, 4, 8, 16, 32}, {0, 1}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* Cost of growing a deep vector from a single cell, with chunks from malloc() (0),
+* from reserved address space (1), and from reserved address space on huge pages (2).
+* 'max_push_us' is the slowest single push, the one that had to grow the vector the most.
+*/
+static void Bench_growth(benchmark::State &state)
+{
+  const size_t items = state.range(0);
+
+  vector_attr_t attr = {};
+  attr.reserve_bytes = (state.range(1) != 0) ? items * sizeof(void *) * 4 : 0;
+  attr.huge_pages = (state.range(1) == 2);
+
+  uint64_t max_push_ns = 0;
+
+  for (auto _ : state)
+  {
+    vector_t *vector = vector_create_attr(1, &attr);
+
+    for (size_t i = 0; i < items; i++)
+    {
+      uint64_t start = monotonic_ns();
+      vector_push(vector, (void *)i);
+      uint64_t elapsed = monotonic_ns() - start;
+
+      if (elapsed > max_push_ns)
+        max_push_ns = elapsed;
+    }
+
+    state.PauseTiming();
+    vector_destroy(vector);
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * items);
+  state.counters["max_push_us"] = max_push_ns / 1000.0;
+}
+
+BENCHMARK(Bench_growth)
+    ->ArgNames({"items", "alloc"})
+    ->ArgsProduct({{1 << 20, 100000000}, {0, 1, 2}})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* Load that grows the vector and lets it shrink back, over and over,
+* without (0) and with (1) a chunk pool. 'allocations' counts chunks per spike.
+*/
+static void Bench_oscillating_load(benchmark::State &state)
+{
+  const size_t spike = state.range(0);
+
+  vector_attr_t attr = {};
+  attr.shrink_threshold = 0.25;
+  attr.shrink_delay = 16;
+  attr.pool_retain_bytes = (state.range(1) != 0) ? spike * sizeof(void *) * 4 : 0;
+
+  vector_t *vector = vector_create_attr(4, &attr);
+  void *data_ptr = nullptr;
+  size_t allocations_before = 0;
+  size_t allocations_after = 0;
+
+  vector_get_allocations(vector, &allocations_before);
+
+  for (auto _ : state)
+  {
+    for (size_t i = 0; i < spike; i++)
+      vector_push(vector, (void *)i);
+
+    for (size_t i = 0; i < spike; i++)
+      vector_pop(vector, &data_ptr);
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+      vector_push(vector, (void *)i);
+      vector_pop(vector, &data_ptr);
+    }
+  }
+
+  vector_get_allocations(vector, &allocations_after);
+  vector_destroy(vector);
+
+  state.SetItemsProcessed(state.iterations() * (spike + 1000));
+  state.counters["allocations"] = benchmark::Counter((double)(allocations_after - allocations_before),
+                                                     benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(Bench_oscillating_load)
+    ->ArgNames({"spike", "pool"})
+    ->ArgsProduct({{1 << 12, 1 << 16}, {0, 1}});
+
+/*
+* Push-to-pop latency of the spsc_simulate() pipeline, with the vector in latency mode.
+* Percentiles cover every element of every iteration.
+*/
+static void Bench_sojourn_latency(benchmark::State &state)
+{
+  const size_t items = state.range(0);
+
+  vector_attr_t attr = {};
+  attr.mode = (vector_mode_t)state.range(1);
+  attr.latency = true;
+
+  vector_t *vector = vector_create_attr(1000, &attr);
+
+  for (auto _ : state)
+  {
+    auto producer = std::thread([=]()
+                                {
+                                  for (size_t iter = 0; iter < items; iter++)
+                                  {
+                                    if (vector_push(vector, (void *)iter) != VECTOR_SUCCESS)
+                                      abort();
+                                  } });
+
+    auto consumer = std::thread([=]()
+                                {
+                                  void *data_ptr = nullptr;
+
+                                  for (size_t iter = 0; iter < items; iter++)
+                                  {
+                                    if (vector_pop(vector, &data_ptr) != VECTOR_SUCCESS)
+                                      abort();
+                                  } });
+
+    producer.join();
+    consumer.join();
+  }
+
+  vector_latency_t latency = {};
+  vector_get_latency(vector, &latency);
+  vector_destroy(vector);
+
+  state.SetItemsProcessed(state.iterations() * items);
+  state.counters["p50_us"] = latency.p50_ns / 1000.0;
+  state.counters["p99_us"] = latency.p99_ns / 1000.0;
+  state.counters["p99.9_us"] = latency.p999_ns / 1000.0;
+  state.counters["max_us"] = latency.max_ns / 1000.0;
+}
+
+BENCHMARK(Bench_sojourn_latency)
+    ->ArgNames({"items", "mode"})
+    ->ArgsProduct({{1 << 10, 1 << 16}, {VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK}})
+    ->UseRealTime();
+
+static inline void sleep_until_ns(uint64_t deadline)
+{
+  struct timespec ts = {(time_t)(deadline / 1000000000), (long)(deadline % 1000000000)};
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+  {
+  }
+}
+
+/*
+* Traffic shaped by a workload_t instead of flat-out pushing.
+* A sampler thread records the depth every millisecond; growth events are chunk allocations,
+* latency is the push-to-pop time measured by the vector itself.
+*/
+static void Bench_workload(benchmark::State &state)
+{
+  workload_t workload;
+  workload.profile = (workload_profile_t)state.range(0);
+  workload.producers = state.range(1);
+  const size_t consumers = state.range(2);
+
+  if (workload.profile == WORKLOAD_TRACE)
+  {
+    const char *path = getenv("MPMC_TRACE");
+
+    if (path == nullptr || !workload_load_trace(workload, path))
+    {
+      state.SkipWithError("set MPMC_TRACE to a readable arrival trace");
+      return;
+    }
+  }
+  else
+  {
+    workload_plan(workload);
+  }
+
+  vector_attr_t attr = {};
+  attr.latency = true;
+
+  size_t allocations = 0;
+  size_t depth_max = 0;
+  double depth_sum = 0;
+  size_t depth_samples = 0;
+  vector_latency_t latency = {};
+
+  for (auto _ : state)
+  {
+    vector_t *vector = vector_create_attr(1000, &attr);
+    std::atomic<size_t> pushed(0);
+    std::atomic<size_t> popped(0);
+    std::atomic<bool> done(false);
+    std::vector<size_t> depth;
+    std::vector<std::thread> threads;
+    const uint64_t start = monotonic_ns();
+
+    for (size_t thread_n = 0; thread_n < workload.producers; thread_n++)
+    {
+      threads.emplace_back([&, thread_n]()
+                           {
+                             for (uint64_t at : workload.arrivals[thread_n])
+                             {
+                               if (monotonic_ns() < start + at)
+                               {
+                                 sleep_until_ns(start + at);
+                               }
+                               pushed.fetch_add(1, std::memory_order_relaxed); // before, so depth never goes negative
+                               if (vector_push(vector, (void *)(uintptr_t)(at + 1)) != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                             } });
+    }
+
+    for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+    {
+      threads.emplace_back([&]()
+                           {
+                             void *data_ptr = nullptr;
+
+                             for (;;)
+                             {
+                               if (vector_pop(vector, &data_ptr) != VECTOR_SUCCESS)
+                               {
+                                 abort();
+                               }
+                               if (data_ptr == nullptr)
+                               {
+                                 break; // end of run
+                               }
+                               popped.fetch_add(1, std::memory_order_relaxed);
+
+                               uint64_t now = monotonic_ns();
+                               uint64_t service = workload_service_ns(workload, now - start);
+                               if (service != 0)
+                               {
+                                 sleep_until_ns(now + service);
+                               }
+                             } });
+    }
+
+    auto sampler = std::thread([&]()
+                               {
+                                 for (uint64_t tick = start; !done.load(std::memory_order_relaxed);)
+                                 {
+                                   tick += 1000000;
+                                   sleep_until_ns(tick);
+                                   size_t out = popped.load(std::memory_order_acquire);
+                                   depth.push_back(pushed.load(std::memory_order_acquire) - out);
+                                 } });
+
+    for (size_t thread_n = 0; thread_n < workload.producers; thread_n++)
+    {
+      threads[thread_n].join();
+    }
+    for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+    {
+      vector_push(vector, nullptr);
+    }
+    for (size_t thread_n = workload.producers; thread_n < threads.size(); thread_n++)
+    {
+      threads[thread_n].join();
+    }
+    done.store(true, std::memory_order_relaxed);
+    sampler.join();
+
+    size_t run_allocations = 0;
+    vector_get_allocations(vector, &run_allocations);
+    allocations += run_allocations;
+    vector_get_latency(vector, &latency);
+    vector_destroy(vector);
+
+    for (size_t sample : depth)
+    {
+      depth_max = std::max(depth_max, sample);
+      depth_sum += sample;
+    }
+    depth_samples += depth.size();
+
+#if LOG_ENABLED == 1
+    std::ofstream depth_logs("workload_depth_" + std::to_string(workload.profile) + ".txt",
+                             std::ios::out | std::ios::trunc);
+    for (size_t ms = 0; ms < depth.size(); ms++)
+    {
+      depth_logs << ms << " " << depth[ms] << "\n";
+    }
+#endif
+  }
+
+  state.SetItemsProcessed(state.iterations() * workload.items);
+  state.counters["depth_mean"] = depth_samples ? depth_sum / depth_samples : 0;
+  state.counters["depth_max"] = depth_max;
+  state.counters["growth_events"] = (double)allocations / state.iterations();
+  state.counters["p50_us"] = latency.p50_ns / 1000.0;
+  state.counters["p99_us"] = latency.p99_ns / 1000.0;
+  state.counters["p99.9_us"] = latency.p999_ns / 1000.0;
+  state.counters["max_us"] = latency.max_ns / 1000.0;
+}
+
+BENCHMARK(Bench_workload)
+    ->ArgNames({"profile", "producers", "consumers"})
+    ->ArgsProduct({{WORKLOAD_POISSON, WORKLOAD_BURST, WORKLOAD_SLOW_CONSUMER, WORKLOAD_SKEWED, WORKLOAD_TRACE},
+                   {1, 4},
+                   {1, 2}})
+    ->Iterations(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/*
+* Consumers waiting on an empty queue: blocked threads against suspended coroutines.
+* One producer thread pushes data_amount elements, then a 0 per consumer to stop it.
+*
+* scheduler 0  every consumer is a thread blocking in pop()
+* scheduler 1  consumers are coroutines on a single-threaded run_loop
+* scheduler 2  consumers are coroutines on a thread_pool of 2 threads
+*/
+enum await_path_t
+{
+  AWAIT_BLOCKING,
+  AWAIT_RUN_LOOP,
+  AWAIT_THREAD_POOL,
+};
+
+template <typename Scheduler>
+detached await_consume(Scheduler &scheduler, mpmc::async_queue<uint64_t, Scheduler> &queue, std::atomic<size_t> &running)
+{
+  co_await scheduler.enter();
+
+  for (;;)
+  {
+    uint64_t value = co_await queue.pop();
+
+    if (value == 0)
+    {
+      break;
+    }
+  }
+
+  running.fetch_sub(1, std::memory_order_release);
+}
+
+template <typename Scheduler>
+void await_simulate(Scheduler &scheduler, size_t consumers, size_t data_amount)
+{
+  mpmc::async_queue<uint64_t, Scheduler> queue(scheduler, 1024);
+  std::atomic<size_t> running{consumers};
+
+  for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+  {
+    await_consume(scheduler, queue, running);
+  }
+
+  std::thread producer([&]()
+                       {
+                         for (uint64_t iter = 1; iter <= data_amount; iter++)
+                         {
+                           queue.push(iter);
+                         }
+                         for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+                         {
+                           queue.push(0);
+                         } });
+  producer.join();
+
+  while (running.load(std::memory_order_acquire) > 0)
+  {
+    std::this_thread::yield();
+  }
+}
+
+static void blocking_simulate(size_t consumers, size_t data_amount)
+{
+  mpmc::queue<uint64_t> queue(1024);
+  std::vector<std::thread> threads;
+
+  for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+  {
+    threads.emplace_back([&]()
+                         {
+                           while (queue.pop() != 0)
+                           {
+                           } });
+  }
+
+  threads.emplace_back([&]()
+                       {
+                         for (uint64_t iter = 1; iter <= data_amount; iter++)
+                         {
+                           queue.push(iter);
+                         }
+                         for (size_t thread_n = 0; thread_n < consumers; thread_n++)
+                         {
+                           queue.push(0);
+                         } });
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+}
+
+static void Bench_await_pop(benchmark::State &state)
+{
+  const await_path_t path = (await_path_t)state.range(0);
+  const size_t consumers = state.range(1);
+  const size_t data_amount = 1 << 18;
+
+  for (auto _ : state)
+  {
+    switch (path)
+    {
+    case AWAIT_BLOCKING:
+      blocking_simulate(consumers, data_amount);
+      break;
+
+    case AWAIT_RUN_LOOP:
+    {
+      run_loop loop;
+      std::thread loop_thread([&]()
+                              { loop.run(); });
+
+      await_simulate(loop, consumers, data_amount);
+
+      loop.stop();
+      loop_thread.join();
+      break;
+    }
+
+    case AWAIT_THREAD_POOL:
+    {
+      thread_pool pool(2);
+
+      await_simulate(pool, consumers, data_amount);
+      break;
+    }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * data_amount);
+  state.counters["consumer_threads"] = path == AWAIT_BLOCKING ? consumers : path == AWAIT_RUN_LOOP ? 1 : 2;
+}
+
+BENCHMARK(Bench_await_pop)
+    ->ArgNames({"scheduler", "consumers"})
+    ->ArgsProduct({{AWAIT_BLOCKING, AWAIT_RUN_LOOP, AWAIT_THREAD_POOL}, {1, 4, 16, 64}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,188 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <benchmark/benchmark.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+/*
+* Hardware and scheduler counters read around each benchmark run through perf_event_open.
+*
+* Counters are opened on the benchmark thread with `inherit` set, so the producer and consumer threads
+* spawned inside the run are counted too: their totals fold into ours when they exit, and every run
+* joins its threads before stop(). Each counter is opened on its own because inherited counters
+* cannot be read as a group.
+*
+* Whatever the kernel refuses (no PMU in a VM, perf_event_paranoid, seccomp) is left out of the report.
+* Context switches fall back to getrusage(), which is always there.
+*/
+class PerfCounters
+{
+public:
+  PerfCounters()
+  {
+    for (size_t i = 0; i < kCount; i++)
+    {
+      fds_[i] = open_counter(kEvents[i].type, kEvents[i].config);
+    }
+
+    if (fds_[kContextSwitches] < 0)
+    {
+      use_rusage_ = true;
+    }
+
+    static bool warned = false;
+    if (!warned && fds_[kCycles] < 0)
+    {
+      std::cerr << "perf_event_open: hardware counters unavailable, reporting what is permitted" << std::endl;
+      warned = true;
+    }
+  }
+
+  ~PerfCounters()
+  {
+    for (size_t i = 0; i < kCount; i++)
+    {
+      if (fds_[i] >= 0)
+      {
+        close(fds_[i]);
+      }
+    }
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  // Counts accumulate across start()/stop() pairs, so call them around every iteration
+  void start()
+  {
+    for (size_t i = 0; i < kCount; i++)
+    {
+      if (fds_[i] >= 0)
+      {
+        ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+
+    if (use_rusage_)
+    {
+      rusage_start_ = rusage_switches();
+    }
+  }
+
+  void stop()
+  {
+    for (size_t i = 0; i < kCount; i++)
+    {
+      if (fds_[i] >= 0)
+      {
+        ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+
+    if (use_rusage_)
+    {
+      rusage_total_ += rusage_switches() - rusage_start_;
+    }
+  }
+
+  // Adds one user counter per available event, divided by `operations` (pushes + pops, or items)
+  void report(benchmark::State &state, uint64_t operations) const
+  {
+    if (operations == 0)
+    {
+      return;
+    }
+
+    for (size_t i = 0; i < kCount; i++)
+    {
+      uint64_t value = 0;
+
+      if (fds_[i] >= 0 && read(fds_[i], &value, sizeof(value)) == (ssize_t)sizeof(value))
+      {
+        state.counters[kEvents[i].name] = (double)value / operations;
+      }
+      else if (i == kContextSwitches && use_rusage_)
+      {
+        state.counters[kEvents[i].name] = (double)rusage_total_ / operations;
+      }
+    }
+  }
+
+private:
+  struct Event
+  {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+  };
+
+  enum
+  {
+    kCycles,
+    kInstructions,
+    kCacheMisses,
+    kLlcMisses,
+    kContextSwitches,
+    kMigrations,
+    kCount
+  };
+
+  static constexpr Event kEvents[kCount] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles/op"},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions/op"},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses/op"},
+      {PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+       "llc_misses/op"},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "ctx_switches/op"},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "migrations/op"},
+  };
+
+  static int open_counter(uint32_t type, uint64_t config)
+  {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+    if (fd < 0)
+    {
+      // perf_event_paranoid >= 2 only allows user-space counting
+      attr.exclude_kernel = 1;
+      fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    return fd;
+  }
+
+  static uint64_t rusage_switches()
+  {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_nvcsw + usage.ru_nivcsw);
+  }
+
+  int fds_[kCount];
+  bool use_rusage_ = false;
+  uint64_t rusage_start_ = 0;
+  uint64_t rusage_total_ = 0;
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,131 @@
+#ifndef SCHEDULERS_H
+#define SCHEDULERS_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Minimal schedulers for mpmc::async_queue, shared by the tests and the benchmarks.
+*
+* run_loop     resumes coroutines on whichever threads call run(), one thread makes it single-threaded
+* thread_pool  a run_loop driven by its own worker threads
+*
+* detached is the coroutine type of the consumers: it starts at once and frees its frame when it returns.
+* A coroutine moves onto a scheduler with `co_await scheduler.enter()`.
+*/
+struct detached
+{
+  struct promise_type
+  {
+    detached get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+class run_loop
+{
+public:
+  void schedule(std::coroutine_handle<> handle)
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      ready_.push_back(handle);
+    }
+    wakeup_.notify_one();
+  }
+
+  // Awaitable continuing the coroutine on a thread of this loop
+  auto enter() noexcept
+  {
+    struct awaiter
+    {
+      run_loop &loop;
+
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle) { loop.schedule(handle); }
+      void await_resume() const noexcept {}
+    };
+
+    return awaiter{*this};
+  }
+
+  // Resume ready coroutines until stop() was called and none is left
+  void run()
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+
+    for (;;)
+    {
+      wakeup_.wait(guard, [this]() { return !ready_.empty() || stopped_; });
+
+      if (ready_.empty())
+      {
+        return;
+      }
+
+      std::coroutine_handle<> handle = ready_.front();
+      ready_.pop_front();
+
+      guard.unlock();
+      handle.resume();
+      guard.lock();
+    }
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      stopped_ = true;
+    }
+    wakeup_.notify_all();
+  }
+
+private:
+  std::mutex lock_;
+  std::condition_variable wakeup_;
+  std::deque<std::coroutine_handle<>> ready_;
+  bool stopped_ = false;
+};
+
+class thread_pool
+{
+public:
+  explicit thread_pool(size_t threads)
+  {
+    for (size_t n = 0; n < threads; n++)
+    {
+      workers_.emplace_back([this]() { loop_.run(); });
+    }
+  }
+
+  // Runs what is still scheduled, then joins the workers
+  ~thread_pool()
+  {
+    loop_.stop();
+
+    for (auto &worker : workers_)
+    {
+      worker.join();
+    }
+  }
+
+  void schedule(std::coroutine_handle<> handle) { loop_.schedule(handle); }
+
+  auto enter() noexcept { return loop_.enter(); }
+
+private:
+  run_loop loop_;
+  std::vector<std::thread> workers_;
+};
+
+#endif // SCHEDULERS_H
@@ -0,0 +1,153 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+* Arrival schedules for the rate-controlled benchmarks.
+*
+* A workload is planned up front: every producer gets the list of instants (ns from the start of the run)
+* at which it must push, and consumers get a service time that depends on when they take an element.
+* Producers run open loop, an arrival that is late is pushed at once instead of being shifted,
+* so a queue that falls behind shows up as depth and latency rather than as a slower generator.
+*/
+enum workload_profile_t
+{
+  WORKLOAD_POISSON,        // exponential inter-arrival times at `rate`
+  WORKLOAD_BURST,          // `burst` back-to-back arrivals, then silence, averaging `rate`
+  WORKLOAD_SLOW_CONSUMER,  // Poisson arrivals, consumers alternate between fast and too-slow phases
+  WORKLOAD_SKEWED,         // Poisson arrivals, producer i carries a share proportional to 1 / (i + 1)
+  WORKLOAD_TRACE,          // arrivals replayed from a file, see workload_load_trace()
+};
+
+struct workload_t
+{
+  workload_profile_t profile = WORKLOAD_POISSON;
+  size_t producers = 1;
+  size_t items = 1 << 15;
+  double rate = 200000.0;            // arrivals per second, all producers together
+  size_t burst = 1024;               // WORKLOAD_BURST
+  uint64_t phase_ns = 20000000;      // WORKLOAD_SLOW_CONSUMER, length of each fast and slow phase
+  uint64_t slow_service_ns = 20000;  // WORKLOAD_SLOW_CONSUMER, per element while slow
+
+  std::vector<std::vector<uint64_t>> arrivals; // [producer][n], ascending
+};
+
+/*
+* Spread `items` Poisson arrivals over the producers according to `weights`.
+*/
+static inline void workload_poisson(workload_t &workload, const std::vector<double> &weights, std::mt19937_64 &rng)
+{
+  std::exponential_distribution<double> gap(workload.rate / 1e9);
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+  double now = 0;
+
+  for (size_t n = 0; n < workload.items; n++)
+  {
+    now += gap(rng);
+    workload.arrivals[pick(rng)].push_back((uint64_t)now);
+  }
+}
+
+/*
+* Fill workload.arrivals for every profile except WORKLOAD_TRACE.
+*/
+static inline void workload_plan(workload_t &workload, uint64_t seed = 1)
+{
+  std::mt19937_64 rng(seed);
+  std::vector<double> weights(workload.producers, 1.0);
+
+  workload.arrivals.assign(workload.producers, {});
+
+  switch (workload.profile)
+  {
+  case WORKLOAD_SKEWED:
+    for (size_t i = 0; i < workload.producers; i++)
+    {
+      weights[i] = 1.0 / (i + 1);
+    }
+    workload_poisson(workload, weights, rng);
+    break;
+
+  case WORKLOAD_BURST:
+  {
+    // Every burst lands at one instant, the silence after it keeps the average at `rate`
+    const uint64_t period = (uint64_t)(workload.burst * 1e9 / workload.rate);
+
+    for (size_t n = 0; n < workload.items; n++)
+    {
+      workload.arrivals[n % workload.producers].push_back((n / workload.burst) * period);
+    }
+    break;
+  }
+
+  case WORKLOAD_POISSON:
+  case WORKLOAD_SLOW_CONSUMER:
+  default:
+    workload_poisson(workload, weights, rng);
+    break;
+  }
+}
+
+/*
+* Load a recorded trace: one arrival per line, "<ns from start> [producer]".
+* Lines without a producer are dealt round robin. Returns false when the file cannot be read or is empty.
+*/
+static inline bool workload_load_trace(workload_t &workload, const std::string &path)
+{
+  std::ifstream trace(path);
+  std::string line;
+  size_t n = 0;
+
+  if (!trace.is_open())
+  {
+    return false;
+  }
+
+  workload.arrivals.assign(workload.producers, {});
+
+  while (std::getline(trace, line))
+  {
+    std::istringstream fields(line);
+    uint64_t at = 0;
+    size_t producer = n;
+
+    if (!(fields >> at))
+    {
+      continue;
+    }
+    fields >> producer;
+
+    workload.arrivals[producer % workload.producers].push_back(at);
+    n++;
+  }
+
+  for (auto &arrivals : workload.arrivals)
+  {
+    std::sort(arrivals.begin(), arrivals.end());
+  }
+
+  workload.items = n;
+  return n > 0;
+}
+
+/*
+* How long a consumer works on an element it took `at` ns into the run.
+*/
+static inline uint64_t workload_service_ns(const workload_t &workload, uint64_t at)
+{
+  if (workload.profile == WORKLOAD_SLOW_CONSUMER && (at / workload.phase_ns) % 2 == 1)
+  {
+    return workload.slow_service_ns;
+  }
+
+  return 0;
+}
+
+#endif // WORKLOAD_H
@@ -0,0 +1,21 @@
+#ifndef CPU_H
+#define CPU_H
+
+#define CACHE_LINE_SIZE 64
+
+/*
+* Hint to the CPU that the thread is spinning,
+* so it saves power and leaves resources to the sibling hyper-thread.
+*/
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#endif // CPU_H
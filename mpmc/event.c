@@ -0,0 +1,139 @@
+/*
+* Event Count.
+*
+* A waiter increments 'sleepers' before its last check of the condition,
+* a notifier reads 'sleepers' after it made the condition true.
+* Both are sequentially consistent, so either the waiter sees the condition,
+* or the notifier sees the waiter and bumps 'seq'.
+*
+* A bumped 'seq' makes FUTEX_WAIT return at once, so a notification
+* issued between the waiter's last check and its sleep is never lost.
+*/
+#define _GNU_SOURCE
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+
+#include "event.h"
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+void event_init(event_t* event);
+
+uint32_t event_prepare_wait(event_t* event);
+void event_cancel_wait(event_t* event);
+bool event_wait(event_t* event, uint32_t key, const struct timespec* deadline);
+
+void event_notify(event_t* event, uint32_t n);
+
+bool event_asymmetric_init(void);
+static void event_asymmetric_register(void);
+uint32_t event_prepare_wait_heavy(event_t* event);
+void event_notify_light(event_t* event, uint32_t n);
+
+static inline long futex_wait(atomic_uint* word, uint32_t expected, const struct timespec* deadline);
+static inline long membarrier(int cmd);
+
+static pthread_once_t event_asymmetric_once = PTHREAD_ONCE_INIT;
+static bool event_asymmetric_ready;
+static inline long futex_wake(atomic_uint* word, uint32_t n);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+void event_init(event_t* event)
+{
+	atomic_init(&event->seq, 0);
+	atomic_init(&event->sleepers, 0);
+}
+
+uint32_t event_prepare_wait(event_t* event)
+{
+	atomic_fetch_add(&event->sleepers, 1);
+
+	return atomic_load(&event->seq);
+}
+
+void event_cancel_wait(event_t* event)
+{
+	atomic_fetch_sub(&event->sleepers, 1);
+}
+
+bool event_wait(event_t* event, uint32_t key, const struct timespec* deadline)
+{
+	// Returns at once if 'seq' moved on, EINTR is treated as a spurious wake-up
+	long ret = futex_wait(&event->seq, key, deadline);
+	bool timed_out = (ret != 0 && errno == ETIMEDOUT);
+
+	atomic_fetch_sub(&event->sleepers, 1);
+
+	return !timed_out;
+}
+
+void event_notify(event_t* event, uint32_t n)
+{
+	if (atomic_load(&event->sleepers) == 0)
+		return;
+
+	atomic_fetch_add(&event->seq, 1);
+	futex_wake(&event->seq, n > INT_MAX ? INT_MAX : n);
+}
+
+bool event_asymmetric_init(void)
+{
+	pthread_once(&event_asymmetric_once, event_asymmetric_register);
+
+	return event_asymmetric_ready;
+}
+
+static void event_asymmetric_register(void)
+{
+	long commands = membarrier(MEMBARRIER_CMD_QUERY);
+
+	event_asymmetric_ready = commands > 0 && (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+							 membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+}
+
+uint32_t event_prepare_wait_heavy(event_t* event)
+{
+	atomic_fetch_add(&event->sleepers, 1);
+
+	// Every notifier either saw the sleeper or made its condition store visible
+	membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+
+	return atomic_load(&event->seq);
+}
+
+void event_notify_light(event_t* event, uint32_t n)
+{
+	atomic_signal_fence(memory_order_seq_cst);
+
+	if (atomic_load_explicit(&event->sleepers, memory_order_relaxed) == 0)
+		return;
+
+	atomic_fetch_add(&event->seq, 1);
+	futex_wake(&event->seq, n > INT_MAX ? INT_MAX : n);
+}
+
+static inline long futex_wait(atomic_uint* word, uint32_t expected, const struct timespec* deadline)
+{
+	// Unlike FUTEX_WAIT, FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout
+	return syscall(SYS_futex, word, FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+static inline long futex_wake(atomic_uint* word, uint32_t n)
+{
+	return syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static inline long membarrier(int cmd)
+{
+	return syscall(SYS_membarrier, cmd, 0, 0);
+}
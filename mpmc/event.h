@@ -0,0 +1,114 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/*
+* Event count built on Linux futexes.
+*
+* Waiter side:
+*	key = event_prepare_wait(event);
+*	if (condition is already true)
+*		event_cancel_wait(event);
+*	else
+*		event_wait(event, key, deadline);
+*
+* Notifier side:
+*	make condition true;
+*	event_notify(event, n);
+*
+* event_notify() costs a single load and no syscall while nobody waits.
+*/
+typedef struct event_t
+{
+	atomic_uint seq;		// futex word, bumped by every notification that sees a sleeper
+	atomic_uint sleepers;	// threads between event_prepare_wait() and the end of event_wait()
+} event_t;
+
+/**
+ * Initialize an event with no sleepers.
+ *
+ * [in] - event
+ */
+void event_init(event_t* event);
+
+/**
+ * Register the calling thread as a sleeper.
+ * The condition must be checked again after this call, before event_wait().
+ *
+ * RETURN VALUES:
+ * key to pass to event_wait()
+ *
+ * [in] - event
+ */
+uint32_t event_prepare_wait(event_t* event);
+
+/**
+ * Unregister the calling thread, when the condition became true after event_prepare_wait().
+ *
+ * [in] - event
+ */
+void event_cancel_wait(event_t* event);
+
+/**
+ * Sleep until a notification issued after event_prepare_wait() arrives,
+ * or until the CLOCK_MONOTONIC `deadline` passes,
+ * then unregister the calling thread. Spurious wake-ups are possible.
+ *
+ * RETURN VALUES:
+ * true  -- woken up
+ * false -- deadline passed
+ *
+ * [in] - event, key, deadline (NULL to wait forever)
+ */
+bool event_wait(event_t* event, uint32_t key, const struct timespec* deadline);
+
+/**
+ * Wake up to `n` sleepers. Does nothing, and makes no syscall, when nobody sleeps.
+ *
+ * [in] - event, n
+ */
+void event_notify(event_t* event, uint32_t n);
+
+/*
+* Asymmetric variant for notifiers that must not pay for a memory fence,
+* e.g. a single producer pushing into a lock-free ring.
+* The notifier orders its condition store with a compiler barrier only,
+* the waiter makes up for it with membarrier(2), which runs a full barrier
+* on every thread of the process. The waiter is in the slow path anyway.
+*
+* Waiter side:  key = event_prepare_wait_heavy(event); ... as above
+* Notifier side: make condition true; event_notify_light(event, n);
+*/
+
+/**
+ * Enable the asymmetric variant for the whole process, once.
+ *
+ * RETURN VALUES:
+ * true  -- event_prepare_wait_heavy() and event_notify_light() may be used
+ * false -- the kernel has no private expedited membarrier, use the plain functions
+ */
+bool event_asymmetric_init(void);
+
+/**
+ * Same as event_prepare_wait(), pairs with event_notify_light().
+ *
+ * RETURN VALUES:
+ * key to pass to event_wait()
+ *
+ * [in] - event
+ */
+uint32_t event_prepare_wait_heavy(event_t* event);
+
+/**
+ * Same as event_notify(), but the condition store needs no memory fence.
+ * Waiters must use event_prepare_wait_heavy().
+ *
+ * [in] - event, n
+ */
+void event_notify_light(event_t* event, uint32_t n);
+
+#endif // EVENT_H
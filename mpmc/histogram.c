@@ -0,0 +1,145 @@
+/*
+* Log-Linear Histogram.
+*
+* Values below 2^SUB_BUCKET_BITS get a bucket each. Every power of two above
+* that is split into 2^(SUB_BUCKET_BITS - 1) buckets of equal width:
+*
+*   value:   0 1 ... 31 | 32 34 ... 62 | 64 68 ... 124 | 128 ...
+*   bucket:  0 1 ... 31 | 32 33 ... 47 | 48 49 ...  63 | 64  ...
+*
+* So a bucket is never wider than 1/16 of its values, and all of uint64_t
+* fits into less than a thousand counters. Recording is a single relaxed
+* atomic add, plus a CAS for a new maximum.
+*/
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "histogram.h"
+
+#define SUB_BUCKET_BITS 5
+#define SUB_BUCKETS (1u << SUB_BUCKET_BITS)
+#define HALF_SUB_BUCKETS (SUB_BUCKETS / 2)
+
+// Largest shift is 64 - SUB_BUCKET_BITS, every shift adds HALF_SUB_BUCKETS buckets
+#define BUCKETS (SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS)
+
+struct histogram_t
+{
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t max;
+	atomic_uint_fast64_t bucket[BUCKETS];
+};
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+histogram_t* histogram_create(void);
+void histogram_destroy(histogram_t* histogram);
+void histogram_record(histogram_t* histogram, uint64_t value);
+uint64_t histogram_count(const histogram_t* histogram);
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile);
+uint64_t histogram_max(const histogram_t* histogram);
+
+static inline size_t histogram_bucket(uint64_t value);
+static inline uint64_t histogram_bucket_end(size_t bucket);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+histogram_t* histogram_create(void)
+{
+	histogram_t* histogram = malloc(sizeof(*histogram));
+
+	if (histogram == NULL)
+		return NULL;
+
+	atomic_init(&histogram->count, 0);
+	atomic_init(&histogram->max, 0);
+
+	for (size_t bucket = 0; bucket < BUCKETS; bucket++)
+		atomic_init(&histogram->bucket[bucket], 0);
+
+	return histogram;
+}
+
+void histogram_destroy(histogram_t* histogram)
+{
+	free(histogram);
+}
+
+void histogram_record(histogram_t* histogram, uint64_t value)
+{
+	atomic_fetch_add_explicit(&histogram->bucket[histogram_bucket(value)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+
+	while (value > max &&
+		   !atomic_compare_exchange_weak_explicit(&histogram->max, &max, value,
+												  memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+uint64_t histogram_count(const histogram_t* histogram)
+{
+	return atomic_load_explicit(&histogram->count, memory_order_relaxed);
+}
+
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile)
+{
+	uint64_t count = histogram_count(histogram);
+
+	if (count == 0)
+		return 0;
+
+	// Rank of the value, 1-based, at least the first one
+	uint64_t rank = (uint64_t)((percentile / 100.0) * (double)count + 0.5);
+	uint64_t seen = 0;
+
+	if (rank == 0)
+		rank = 1;
+
+	for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+		seen += atomic_load_explicit(&histogram->bucket[bucket], memory_order_relaxed);
+
+		if (seen >= rank) {
+			uint64_t end = histogram_bucket_end(bucket);
+			uint64_t max = histogram_max(histogram);
+
+			return (end < max) ? end : max;
+		}
+	}
+
+	// Counted before its bucket was, in the middle of histogram_record()
+	return histogram_max(histogram);
+}
+
+uint64_t histogram_max(const histogram_t* histogram)
+{
+	return atomic_load_explicit(&histogram->max, memory_order_relaxed);
+}
+
+static inline size_t histogram_bucket(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+		return (size_t)value;
+
+	unsigned int shift = (unsigned int)(63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1);
+	uint64_t top = value >> shift;		// HALF_SUB_BUCKETS up to SUB_BUCKETS - 1
+
+	return SUB_BUCKETS + (shift - 1) * HALF_SUB_BUCKETS + (size_t)(top - HALF_SUB_BUCKETS);
+}
+
+// Largest value that falls into the bucket
+static inline uint64_t histogram_bucket_end(size_t bucket)
+{
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	unsigned int shift = (unsigned int)((bucket - SUB_BUCKETS) / HALF_SUB_BUCKETS) + 1;
+	uint64_t top = (bucket - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+
+	return ((top + 1) << shift) - 1;
+}
@@ -0,0 +1,57 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+* Lock-free histogram of 64-bit values with a bounded relative error,
+* used for the push-to-pop latency of a vector, see vector_get_latency().
+*/
+typedef struct histogram_t histogram_t;
+
+/**
+ * Create an empty histogram.
+ *
+ * RETURN VALUES:
+ * histogram_t pointer
+ * NULL pointer -- when failed to allocate memory
+ */
+histogram_t* histogram_create(void);
+
+/**
+ * Destroy the histogram. No other thread may use it anymore.
+ *
+ * [in] - histogram
+ */
+void histogram_destroy(histogram_t* histogram);
+
+/**
+ * Count a value. Safe to call from many threads at once.
+ *
+ * [in] - histogram, value
+ */
+void histogram_record(histogram_t* histogram, uint64_t value);
+
+/**
+ * Get the number of recorded values.
+ *
+ * [in] - histogram
+ */
+uint64_t histogram_count(const histogram_t* histogram);
+
+/**
+ * Get the value that `percentile` percent of the recorded values do not exceed,
+ * rounded up to the end of its bucket, or 0 when nothing is recorded.
+ *
+ * [in] - histogram, percentile (0 to 100)
+ */
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile);
+
+/**
+ * Get the largest recorded value, exact.
+ *
+ * [in] - histogram
+ */
+uint64_t histogram_max(const histogram_t* histogram);
+
+#endif // HISTOGRAM_H
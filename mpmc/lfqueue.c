@@ -0,0 +1,409 @@
+/*
+* Lock-Free Unbounded Queue.
+*
+* The queue is a linked list of segments, each segment is an array of slots
+* with its own enqueue and dequeue tickets:
+*
+*   head                         tail
+*    |                            |
+*   |x|x|3|4|5| -> |6|7|8|9|10| -> |11|.|.|.|.| -> NULL
+*        |                             |
+*     deq_idx                       enq_idx
+*
+* Producer takes a ticket with fetch_add(enq_idx) and stores its element into
+* that slot with CAS(NULL -> element). Consumer takes a ticket with
+* fetch_add(deq_idx) and swaps the slot with TAKEN. If the consumer came first,
+* the producer's CAS fails and it simply takes another ticket.
+*
+* When the tail segment runs out of tickets, a new segment is linked to it.
+* When the head segment runs out of tickets, head moves to the next segment
+* and the old one is retired.
+*
+* Retired segments are freed only when no thread holds a hazard pointer to
+* them, so a thread that loaded 'head' or 'tail' just before it moved can
+* still safely touch the old segment.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "lfqueue.h"
+#include "cpu.h"
+#include "debug.h"
+
+// Retired segments are scanned once that many of them have piled up
+#define RETIRED_SCAN_THRESHOLD 8
+
+typedef struct lfq_segment_t lfq_segment_t;
+typedef struct lfq_hazard_t lfq_hazard_t;
+
+struct lfq_segment_t
+{
+	alignas(CACHE_LINE_SIZE) atomic_size_t deq_idx;
+	alignas(CACHE_LINE_SIZE) atomic_size_t enq_idx;
+	alignas(CACHE_LINE_SIZE) _Atomic(lfq_segment_t*) next;
+
+	lfq_segment_t* retired_next;	// link in the retired list, 'next' must stay intact
+	size_t size;
+
+	_Atomic(void*) slot[];
+};
+
+struct lfq_hazard_t
+{
+	alignas(CACHE_LINE_SIZE) _Atomic(void*) pointer;
+	atomic_int active;
+
+	lfq_hazard_t* next;
+};
+
+struct lfqueue_t
+{
+	alignas(CACHE_LINE_SIZE) _Atomic(lfq_segment_t*) head;
+	alignas(CACHE_LINE_SIZE) _Atomic(lfq_segment_t*) tail;
+
+	alignas(CACHE_LINE_SIZE) _Atomic(lfq_hazard_t*) hazards;
+	_Atomic(lfq_segment_t*) retired;
+	atomic_size_t retired_count;
+
+	size_t segment_size;
+	unsigned long id;
+};
+
+/*
+* Slot values.
+* NULL is a valid element, so it is stored as LFQ_NULL.
+*/
+static char lfq_null_marker;
+static char lfq_taken_marker;
+
+#define LFQ_NULL  ((void*)&lfq_null_marker)
+#define LFQ_TAKEN ((void*)&lfq_taken_marker)
+
+/*
+* Last hazard record used by this thread, tried first on the next operation.
+* The record is identified by the queue id, not by the queue address,
+* because an address can be reused by a new queue after the old one is destroyed.
+*/
+static atomic_ulong lfq_next_id = 1;
+static _Thread_local unsigned long lfq_hint_id;
+static _Thread_local lfq_hazard_t* lfq_hint_hazard;
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+lfqueue_t* lfqueue_create(size_t segment_size);
+void lfqueue_destroy(lfqueue_t* queue);
+
+vector_ret_t lfqueue_enqueue(lfqueue_t* queue, void* element);
+bool lfqueue_dequeue(lfqueue_t* queue, void** p_element);
+
+static lfq_segment_t* lfq_segment_create(size_t size, void* first_element);
+
+static lfq_hazard_t* lfq_hazard_acquire(lfqueue_t* queue);
+static void lfq_hazard_release(lfq_hazard_t* hazard);
+static lfq_segment_t* lfq_hazard_protect(lfq_hazard_t* hazard, _Atomic(lfq_segment_t*)* source);
+
+static void lfq_retire(lfqueue_t* queue, lfq_segment_t* segment);
+static void lfq_scan(lfqueue_t* queue);
+static bool lfq_is_hazardous(lfqueue_t* queue, lfq_segment_t* segment);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+lfqueue_t* lfqueue_create(size_t segment_size)
+{
+	lfqueue_t* queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(*queue));
+
+	if (queue == NULL)
+		return NULL;
+
+	queue->segment_size = segment_size == 0 ? 1 : segment_size;
+	queue->id = atomic_fetch_add(&lfq_next_id, 1);
+
+	lfq_segment_t* segment = lfq_segment_create(queue->segment_size, NULL);
+
+	if (segment == NULL) {
+		debug_print("Not enough memory for segment size: %zu\n", queue->segment_size);
+		free(queue);
+		return NULL;
+	}
+
+	atomic_init(&queue->head, segment);
+	atomic_init(&queue->tail, segment);
+	atomic_init(&queue->hazards, NULL);
+	atomic_init(&queue->retired, NULL);
+	atomic_init(&queue->retired_count, 0);
+
+	return queue;
+}
+
+void lfqueue_destroy(lfqueue_t* queue)
+{
+	lfq_segment_t* segment = atomic_load(&queue->head);
+
+	while (segment != NULL) {
+		lfq_segment_t* next = atomic_load(&segment->next);
+		free(segment);
+		segment = next;
+	}
+
+	segment = atomic_load(&queue->retired);
+
+	while (segment != NULL) {
+		lfq_segment_t* next = segment->retired_next;
+		free(segment);
+		segment = next;
+	}
+
+	lfq_hazard_t* hazard = atomic_load(&queue->hazards);
+
+	while (hazard != NULL) {
+		lfq_hazard_t* next = hazard->next;
+		free(hazard);
+		hazard = next;
+	}
+
+	free(queue);
+}
+
+vector_ret_t lfqueue_enqueue(lfqueue_t* queue, void* element)
+{
+	void* item = (element == NULL) ? LFQ_NULL : element;
+
+	lfq_hazard_t* hazard = lfq_hazard_acquire(queue);
+
+	if (hazard == NULL)
+		return VECTOR_FAILURE;
+
+	for (;;) {
+		lfq_segment_t* segment = lfq_hazard_protect(hazard, &queue->tail);
+
+		size_t idx = atomic_fetch_add(&segment->enq_idx, 1);
+
+		if (idx < segment->size) {
+			void* expected = NULL;
+
+			if (atomic_compare_exchange_strong(&segment->slot[idx], &expected, item))
+				break;
+
+			continue;	// consumer gave up on this slot, take another ticket
+		}
+
+		// Segment is FULL
+		if (segment != atomic_load(&queue->tail))
+			continue;
+
+		lfq_segment_t* next = atomic_load(&segment->next);
+
+		if (next != NULL) {
+			atomic_compare_exchange_strong(&queue->tail, &segment, next);
+			continue;
+		}
+
+		lfq_segment_t* new_segment = lfq_segment_create(queue->segment_size, item);
+
+		if (new_segment == NULL) {
+			debug_print("Not enough memory for segment size: %zu\n", queue->segment_size);
+			lfq_hazard_release(hazard);
+			return VECTOR_FAILURE;
+		}
+
+		if (atomic_compare_exchange_strong(&segment->next, &next, new_segment)) {
+			atomic_compare_exchange_strong(&queue->tail, &segment, new_segment);
+			break;
+		}
+
+		free(new_segment);	// was never published
+	}
+
+	lfq_hazard_release(hazard);
+
+	return VECTOR_SUCCESS;
+}
+
+bool lfqueue_dequeue(lfqueue_t* queue, void** p_element)
+{
+	lfq_hazard_t* hazard = lfq_hazard_acquire(queue);
+
+	if (hazard == NULL)
+		return false;
+
+	for (;;) {
+		lfq_segment_t* segment = lfq_hazard_protect(hazard, &queue->head);
+
+		if (atomic_load(&segment->deq_idx) >= atomic_load(&segment->enq_idx) &&
+			atomic_load(&segment->next) == NULL)
+			break;	// queue is EMPTY
+
+		size_t idx = atomic_fetch_add(&segment->deq_idx, 1);
+
+		if (idx < segment->size) {
+			void* item = atomic_exchange(&segment->slot[idx], LFQ_TAKEN);
+
+			if (item == NULL)
+				continue;	// producer has not stored its element yet, it will retry
+
+			*p_element = (item == LFQ_NULL) ? NULL : item;
+			lfq_hazard_release(hazard);
+			return true;
+		}
+
+		// Segment is DRAINED
+		lfq_segment_t* next = atomic_load(&segment->next);
+
+		if (next == NULL)
+			break;
+
+		// 'tail' must not lag behind 'head', otherwise a retired segment stays reachable
+		lfq_segment_t* expected = segment;
+		atomic_compare_exchange_strong(&queue->tail, &expected, next);
+
+		if (atomic_compare_exchange_strong(&queue->head, &segment, next)) {
+			atomic_store(&hazard->pointer, NULL);	// do not keep our own segment alive
+			lfq_retire(queue, segment);
+		}
+	}
+
+	lfq_hazard_release(hazard);
+
+	return false;
+}
+
+static lfq_segment_t* lfq_segment_create(size_t size, void* first_element)
+{
+	size_t bytes = sizeof(lfq_segment_t) + size * sizeof(_Atomic(void*));
+
+	// aligned_alloc() requires size to be a multiple of the alignment
+	bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+	lfq_segment_t* segment = aligned_alloc(CACHE_LINE_SIZE, bytes);
+
+	if (segment == NULL)
+		return NULL;
+
+	atomic_init(&segment->deq_idx, 0);
+	atomic_init(&segment->enq_idx, first_element == NULL ? 0 : 1);
+	atomic_init(&segment->next, NULL);
+	segment->retired_next = NULL;
+	segment->size = size;
+
+	for (size_t idx = 0; idx < size; idx++)
+		atomic_init(&segment->slot[idx], NULL);
+
+	if (first_element != NULL)
+		atomic_init(&segment->slot[0], first_element);
+
+	return segment;
+}
+
+static lfq_hazard_t* lfq_hazard_acquire(lfqueue_t* queue)
+{
+	lfq_hazard_t* hazard = lfq_hint_hazard;
+	int expected = 0;
+
+	if (lfq_hint_id == queue->id &&
+		atomic_compare_exchange_strong(&hazard->active, &expected, 1))
+		return hazard;
+
+	// Reuse any free record of this queue
+	for (hazard = atomic_load(&queue->hazards); hazard != NULL; hazard = hazard->next) {
+		expected = 0;
+
+		if (atomic_compare_exchange_strong(&hazard->active, &expected, 1)) {
+			lfq_hint_id = queue->id;
+			lfq_hint_hazard = hazard;
+			return hazard;
+		}
+	}
+
+	// All records are busy, add a new one. Records live until the queue is destroyed
+	hazard = aligned_alloc(CACHE_LINE_SIZE, sizeof(*hazard));
+
+	if (hazard == NULL)
+		return NULL;
+
+	atomic_init(&hazard->pointer, NULL);
+	atomic_init(&hazard->active, 1);
+	hazard->next = atomic_load(&queue->hazards);
+
+	while (!atomic_compare_exchange_weak(&queue->hazards, &hazard->next, hazard))
+		;
+
+	lfq_hint_id = queue->id;
+	lfq_hint_hazard = hazard;
+
+	return hazard;
+}
+
+static void lfq_hazard_release(lfq_hazard_t* hazard)
+{
+	atomic_store_explicit(&hazard->pointer, NULL, memory_order_release);
+	atomic_store_explicit(&hazard->active, 0, memory_order_release);
+}
+
+static lfq_segment_t* lfq_hazard_protect(lfq_hazard_t* hazard, _Atomic(lfq_segment_t*)* source)
+{
+	lfq_segment_t* segment = atomic_load(source);
+
+	for (;;) {
+		atomic_store(&hazard->pointer, segment);
+
+		// Segment is safe only if it was still reachable after the hazard became visible
+		lfq_segment_t* current = atomic_load(source);
+
+		if (current == segment)
+			return segment;
+
+		segment = current;
+	}
+}
+
+static void lfq_retire(lfqueue_t* queue, lfq_segment_t* segment)
+{
+	segment->retired_next = atomic_load(&queue->retired);
+
+	while (!atomic_compare_exchange_weak(&queue->retired, &segment->retired_next, segment))
+		;
+
+	if (atomic_fetch_add(&queue->retired_count, 1) + 1 >= RETIRED_SCAN_THRESHOLD)
+		lfq_scan(queue);
+}
+
+static void lfq_scan(lfqueue_t* queue)
+{
+	// Take the whole retired list, so no other thread scans the same segments
+	lfq_segment_t* segment = atomic_exchange(&queue->retired, NULL);
+
+	while (segment != NULL) {
+		lfq_segment_t* next = segment->retired_next;
+
+		if (lfq_is_hazardous(queue, segment)) {
+			// Still in use, put it back for a later scan
+			segment->retired_next = atomic_load(&queue->retired);
+
+			while (!atomic_compare_exchange_weak(&queue->retired, &segment->retired_next, segment))
+				;
+		}
+		else {
+			atomic_fetch_sub(&queue->retired_count, 1);
+			free(segment);
+		}
+
+		segment = next;
+	}
+}
+
+static bool lfq_is_hazardous(lfqueue_t* queue, lfq_segment_t* segment)
+{
+	for (lfq_hazard_t* hazard = atomic_load(&queue->hazards); hazard != NULL; hazard = hazard->next) {
+		if (atomic_load(&hazard->pointer) == segment)
+			return true;
+	}
+
+	return false;
+}
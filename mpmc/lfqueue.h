@@ -0,0 +1,56 @@
+#ifndef LFQUEUE_H
+#define LFQUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+/*
+* Lock-free unbounded queue used by VECTOR_MODE_LOCKFREE.
+* It never blocks: waiting for data is done by the vector layer.
+*/
+typedef struct lfqueue_t lfqueue_t;
+
+/**
+ * Create a lock-free queue made of linked segments of `segment_size` slots.
+ *
+ * RETURN VALUES:
+ * lfqueue_t pointer
+ * NULL pointer -- when failed to allocate memory
+ *
+ * [in] - segment_size
+ */
+lfqueue_t* lfqueue_create(size_t segment_size);
+
+/**
+ * Destroy the queue. No other thread may use it anymore.
+ *
+ * [in] - queue
+ */
+void lfqueue_destroy(lfqueue_t* queue);
+
+/**
+ * Add an element to the tail of the queue.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- malloc failed when linking a new segment
+ *
+ * [in] - queue, element
+ */
+vector_ret_t lfqueue_enqueue(lfqueue_t* queue, void* element);
+
+/**
+ * Remove an element from the head of the queue.
+ *
+ * RETURN VALUES:
+ * true  -- element was removed
+ * false -- queue is empty
+ *
+ * [in] - queue
+ * [out] - p_element
+ */
+bool lfqueue_dequeue(lfqueue_t* queue, void** p_element);
+
+#endif // LFQUEUE_H
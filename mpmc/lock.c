@@ -0,0 +1,286 @@
+/*
+* Lock Backends.
+*
+* VECTOR_LOCK_MUTEX     default pthread mutex, sleeps in the kernel when taken
+* VECTOR_LOCK_ADAPTIVE  glibc adaptive mutex, spins a little before sleeping
+* VECTOR_LOCK_TTAS      test and test-and-set: waiters read the flag and only write it once it looks free
+* VECTOR_LOCK_TICKET    FIFO: take a number, wait until it is served
+* VECTOR_LOCK_MCS       FIFO queue of waiters, each spinning on its own cache line:
+*
+*   tail ------------------------------------------.
+*                                                  v
+*   holder -> [node|locked=0] -> [node|locked=1] -> [node|locked=1] -> NULL
+*                                 spins here        spins here
+*
+* The owner hands the lock to the next node by clearing its 'locked' flag,
+* so a release touches one waiter's cache line instead of every waiter's.
+*
+* MCS nodes live in the acquiring thread. The vector nests at most a side's lock and 'slot_guard',
+* so a few nodes per thread are enough; each acquisition takes a free one and the release frees it,
+* in whatever order the locks are released.
+*
+* Spinning backends never sleep. They pause for LOCK_SPIN_LIMIT rounds, then yield the CPU between
+* attempts, so the owner still gets to run when there are more threads than cores.
+*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+
+#include "lock.h"
+
+#define LOCK_SPIN_LIMIT 128
+
+// MCS nodes per thread, that many MCS locks may be held at once
+#define LOCK_MCS_NODES 8
+
+static _Thread_local lock_mcs_node_t lock_mcs_nodes[LOCK_MCS_NODES];
+static _Thread_local unsigned int lock_mcs_used;	// bit per node in use
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+int lock_init(lock_t* lock, vector_lock_t kind);
+void lock_destroy(lock_t* lock);
+int lock_acquire(lock_t* lock);
+int lock_try_acquire(lock_t* lock);
+int lock_release(lock_t* lock);
+
+static inline void lock_backoff(unsigned int* spins);
+static inline lock_mcs_node_t* lock_mcs_node_take(void);
+static inline void lock_mcs_node_give(lock_mcs_node_t* node);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+int lock_init(lock_t* lock, vector_lock_t kind)
+{
+	lock->kind = kind;
+
+	switch (kind) {
+	case VECTOR_LOCK_MUTEX:
+		return pthread_mutex_init(&lock->mutex, NULL);
+
+	case VECTOR_LOCK_ADAPTIVE:
+	{
+		pthread_mutexattr_t attr;
+		int ret = pthread_mutexattr_init(&attr);
+
+		if (ret == 0)
+			ret = pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+		if (ret == 0)
+			ret = pthread_mutex_init(&lock->mutex, &attr);
+
+		pthread_mutexattr_destroy(&attr);
+		return ret;
+	}
+
+	case VECTOR_LOCK_TTAS:
+		atomic_init(&lock->taken, false);
+		return 0;
+
+	case VECTOR_LOCK_TICKET:
+		atomic_init(&lock->ticket.next, 0);
+		atomic_init(&lock->ticket.serving, 0);
+		return 0;
+
+	case VECTOR_LOCK_MCS:
+		atomic_init(&lock->mcs.tail, NULL);
+		lock->mcs.holder = NULL;
+		return 0;
+	}
+
+	return EINVAL;
+}
+
+void lock_destroy(lock_t* lock)
+{
+	if (lock->kind == VECTOR_LOCK_MUTEX || lock->kind == VECTOR_LOCK_ADAPTIVE)
+		pthread_mutex_destroy(&lock->mutex);
+}
+
+int lock_acquire(lock_t* lock)
+{
+	unsigned int spins = 0;
+
+	switch (lock->kind) {
+	case VECTOR_LOCK_MUTEX:
+	case VECTOR_LOCK_ADAPTIVE:
+		return pthread_mutex_lock(&lock->mutex);
+
+	case VECTOR_LOCK_TTAS:
+		for (;;) {
+			if (!atomic_load_explicit(&lock->taken, memory_order_relaxed) &&
+				!atomic_exchange_explicit(&lock->taken, true, memory_order_acquire))
+				return 0;
+
+			lock_backoff(&spins);
+		}
+
+	case VECTOR_LOCK_TICKET:
+	{
+		unsigned int ticket = atomic_fetch_add_explicit(&lock->ticket.next, 1, memory_order_relaxed);
+
+		while (atomic_load_explicit(&lock->ticket.serving, memory_order_acquire) != ticket)
+			lock_backoff(&spins);
+
+		return 0;
+	}
+
+	case VECTOR_LOCK_MCS:
+	{
+		lock_mcs_node_t* node = lock_mcs_node_take();
+
+		if (node == NULL)
+			return EAGAIN;
+
+		atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+		atomic_store_explicit(&node->locked, true, memory_order_relaxed);
+
+		lock_mcs_node_t* prev = atomic_exchange_explicit(&lock->mcs.tail, node, memory_order_acq_rel);
+
+		if (prev != NULL) {
+			atomic_store_explicit(&prev->next, node, memory_order_release);
+
+			while (atomic_load_explicit(&node->locked, memory_order_acquire))
+				lock_backoff(&spins);
+		}
+
+		lock->mcs.holder = node;
+		return 0;
+	}
+	}
+
+	return EINVAL;
+}
+
+int lock_try_acquire(lock_t* lock)
+{
+	switch (lock->kind) {
+	case VECTOR_LOCK_MUTEX:
+	case VECTOR_LOCK_ADAPTIVE:
+		return pthread_mutex_trylock(&lock->mutex);
+
+	case VECTOR_LOCK_TTAS:
+		if (!atomic_load_explicit(&lock->taken, memory_order_relaxed) &&
+			!atomic_exchange_explicit(&lock->taken, true, memory_order_acquire))
+			return 0;
+
+		return EBUSY;
+
+	case VECTOR_LOCK_TICKET:
+	{
+		// Acquire pairs with the release of the previous owner, the CAS below only claims the ticket
+		unsigned int serving = atomic_load_explicit(&lock->ticket.serving, memory_order_acquire);
+		unsigned int next = serving;
+
+		// Only when nobody holds or waits for the lock, otherwise the ticket could not be given back
+		if (atomic_compare_exchange_strong_explicit(&lock->ticket.next, &next, serving + 1,
+													memory_order_relaxed, memory_order_relaxed))
+			return 0;
+
+		return EBUSY;
+	}
+
+	case VECTOR_LOCK_MCS:
+	{
+		lock_mcs_node_t* node = lock_mcs_node_take();
+		lock_mcs_node_t* expected = NULL;
+
+		if (node == NULL)
+			return EAGAIN;
+
+		atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+		if (atomic_compare_exchange_strong_explicit(&lock->mcs.tail, &expected, node,
+													memory_order_acq_rel, memory_order_relaxed)) {
+			lock->mcs.holder = node;
+			return 0;
+		}
+
+		lock_mcs_node_give(node);
+		return EBUSY;
+	}
+	}
+
+	return EINVAL;
+}
+
+int lock_release(lock_t* lock)
+{
+	switch (lock->kind) {
+	case VECTOR_LOCK_MUTEX:
+	case VECTOR_LOCK_ADAPTIVE:
+		return pthread_mutex_unlock(&lock->mutex);
+
+	case VECTOR_LOCK_TTAS:
+		atomic_store_explicit(&lock->taken, false, memory_order_release);
+		return 0;
+
+	case VECTOR_LOCK_TICKET:
+		// Only the owner writes 'serving'
+		atomic_store_explicit(&lock->ticket.serving,
+							  atomic_load_explicit(&lock->ticket.serving, memory_order_relaxed) + 1,
+							  memory_order_release);
+		return 0;
+
+	case VECTOR_LOCK_MCS:
+	{
+		lock_mcs_node_t* node = lock->mcs.holder;
+		lock_mcs_node_t* next = atomic_load_explicit(&node->next, memory_order_acquire);
+
+		if (next == NULL) {
+			lock_mcs_node_t* expected = node;
+
+			// No waiter, the lock becomes free
+			if (atomic_compare_exchange_strong_explicit(&lock->mcs.tail, &expected, NULL,
+														memory_order_acq_rel, memory_order_relaxed)) {
+				lock_mcs_node_give(node);
+				return 0;
+			}
+
+			// A waiter swapped the tail but did not link itself yet
+			unsigned int spins = 0;
+
+			while ((next = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL)
+				lock_backoff(&spins);
+		}
+
+		atomic_store_explicit(&next->locked, false, memory_order_release);
+		lock_mcs_node_give(node);
+		return 0;
+	}
+	}
+
+	return EINVAL;
+}
+
+static inline void lock_backoff(unsigned int* spins)
+{
+	if (*spins < LOCK_SPIN_LIMIT) {
+		(*spins)++;
+		cpu_relax();
+	}
+	else {
+		sched_yield();
+	}
+}
+
+static inline lock_mcs_node_t* lock_mcs_node_take(void)
+{
+	for (unsigned int i = 0; i < LOCK_MCS_NODES; i++) {
+		if (!(lock_mcs_used & (1u << i))) {
+			lock_mcs_used |= 1u << i;
+			return &lock_mcs_nodes[i];
+		}
+	}
+
+	return NULL;
+}
+
+static inline void lock_mcs_node_give(lock_mcs_node_t* node)
+{
+	lock_mcs_used &= ~(1u << (unsigned int)(node - lock_mcs_nodes));
+}
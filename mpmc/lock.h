@@ -0,0 +1,94 @@
+#ifndef LOCK_H
+#define LOCK_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "vector.h"
+#include "cpu.h"
+
+/*
+* Lock guarding the sides of a chunk ring vector, see vector_attr_t 'lock'.
+* Every backend has the same calls, so the vector does not care which one it runs on.
+* Functions return 0 on success and an errno value otherwise, like pthread_mutex_*().
+*/
+typedef struct lock_mcs_node_t
+{
+	_Alignas(CACHE_LINE_SIZE) struct lock_mcs_node_t* _Atomic next;
+	atomic_bool locked;		// the waiter spins on its own node only
+} lock_mcs_node_t;
+
+typedef struct lock_t
+{
+	vector_lock_t kind;
+
+	union
+	{
+		pthread_mutex_t mutex;	// VECTOR_LOCK_MUTEX and VECTOR_LOCK_ADAPTIVE
+
+		atomic_bool taken;		// VECTOR_LOCK_TTAS
+
+		struct					// VECTOR_LOCK_TICKET
+		{
+			atomic_uint next;
+			atomic_uint serving;
+		} ticket;
+
+		struct					// VECTOR_LOCK_MCS
+		{
+			lock_mcs_node_t* _Atomic tail;
+			lock_mcs_node_t* holder;	// node of the owner, written under the lock
+		} mcs;
+	};
+} lock_t;
+
+/**
+ * Initialize an unlocked lock of the given kind.
+ *
+ * RETURN VALUES:
+ * 0
+ * EINVAL -- unknown kind
+ * errno value of pthread_mutex_init()
+ *
+ * [in] - lock, kind
+ */
+int lock_init(lock_t* lock, vector_lock_t kind);
+
+/**
+ * Release resources of an unlocked lock.
+ *
+ * [in] - lock
+ */
+void lock_destroy(lock_t* lock);
+
+/**
+ * Take the lock, waiting as long as it takes.
+ * Spinning backends pause for a while, then yield the CPU between attempts.
+ *
+ * RETURN VALUES:
+ * 0
+ * EAGAIN -- VECTOR_LOCK_MCS only, the calling thread holds too many MCS locks at once
+ *
+ * [in] - lock
+ */
+int lock_acquire(lock_t* lock);
+
+/**
+ * Take the lock if it is free.
+ *
+ * RETURN VALUES:
+ * 0
+ * EBUSY -- the lock is taken
+ *
+ * [in] - lock
+ */
+int lock_try_acquire(lock_t* lock);
+
+/**
+ * Release a lock taken by the calling thread.
+ *
+ * [in] - lock
+ */
+int lock_release(lock_t* lock);
+
+#endif // LOCK_H
@@ -0,0 +1,175 @@
+/*
+* Chunk Recycling Pool.
+*
+* A vector that shrinks after a spike frees its chunks, and allocates them
+* again on the next spike. Under oscillating load that puts the allocator
+* on every growth. The pool keeps freed chunks instead:
+*
+*   shrink:  vector -> |chunk| -> pool (or free() once 'retain_bytes' is reached)
+*   grow:    pool -> smallest chunk that is large enough -> vector
+*
+* Chunks are kept in a list sorted by size, so the best fit is the first
+* large enough one. The list link is stored in the chunk memory itself.
+*
+* The pool has its own mutex and takes no other lock under it.
+* Vectors mostly call it with their locks released, but vector_make_room() hands back
+* a chunk it lost the race for while holding the producer lock, so the order is
+* the producer lock of a vector, then the pool's mutex.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "pool.h"
+#include "debug.h"
+
+#define CHECK_AND_RETURN_IF_NOT_EXIST(pointer_object)  \
+    do{                                                \
+        if (pointer_object == NULL)                    \
+        {                                              \
+            debug_print("Object does not exist\n");    \
+            return VECTOR_FAILURE;                     \
+        }                                              \
+    }while(0)
+
+typedef struct pool_block_t pool_block_t;
+
+// Header written over a retained chunk
+struct pool_block_t
+{
+	pool_block_t* next;		// next larger or equal block
+	size_t bytes;
+};
+
+struct pool_t
+{
+	pthread_mutex_t guard;
+	size_t retain_bytes;
+
+	pool_block_t* blocks;	// smallest first
+	pool_stats_t stats;
+};
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+pool_t* pool_create(size_t retain_bytes);
+vector_ret_t pool_destroy(pool_t* pool);
+vector_ret_t pool_get_stats(pool_t* pool, pool_stats_t* p_stats);
+void* pool_get(pool_t* pool, size_t min_bytes, size_t* p_bytes);
+bool pool_put(pool_t* pool, void* memory, size_t bytes);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+pool_t* pool_create(size_t retain_bytes)
+{
+	pool_t* pool = malloc(sizeof(*pool));
+
+	if (pool == NULL)
+		return NULL;
+
+	if (pthread_mutex_init(&pool->guard, NULL) != 0) {
+		free(pool);
+		return NULL;
+	}
+
+	pool->retain_bytes = retain_bytes;
+	pool->blocks = NULL;
+	pool->stats = (pool_stats_t){ 0 };
+
+	return pool;
+}
+
+vector_ret_t pool_destroy(pool_t* pool)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(pool);
+
+	while (pool->blocks != NULL) {
+		pool_block_t* next = pool->blocks->next;
+		free(pool->blocks);
+		pool->blocks = next;
+	}
+
+	pthread_mutex_destroy(&pool->guard);
+	free(pool);
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t pool_get_stats(pool_t* pool, pool_stats_t* p_stats)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(pool);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_stats);
+
+	if (pthread_mutex_lock(&pool->guard) != 0)
+		return VECTOR_FAILURE;
+
+	*p_stats = pool->stats;
+
+	if (pthread_mutex_unlock(&pool->guard) != 0)
+		return VECTOR_FAILURE;
+
+	return VECTOR_SUCCESS;
+}
+
+void* pool_get(pool_t* pool, size_t min_bytes, size_t* p_bytes)
+{
+	pool_block_t* block = NULL;
+
+	pthread_mutex_lock(&pool->guard);
+
+	for (pool_block_t** link = &pool->blocks; *link != NULL; link = &(*link)->next) {
+		if ((*link)->bytes >= min_bytes) {
+			block = *link;
+			*link = block->next;
+			break;
+		}
+	}
+
+	if (block != NULL) {
+		pool->stats.hits++;
+		pool->stats.retained_chunks--;
+		pool->stats.retained_bytes -= block->bytes;
+		*p_bytes = block->bytes;
+	}
+	else {
+		pool->stats.misses++;
+	}
+
+	pthread_mutex_unlock(&pool->guard);
+
+	return block;
+}
+
+bool pool_put(pool_t* pool, void* memory, size_t bytes)
+{
+	pool_block_t* block = memory;
+	bool kept = false;
+
+	pthread_mutex_lock(&pool->guard);
+
+	if (bytes >= sizeof(*block) && pool->stats.retained_bytes + bytes <= pool->retain_bytes) {
+		pool_block_t** link = &pool->blocks;
+
+		while (*link != NULL && (*link)->bytes < bytes)
+			link = &(*link)->next;
+
+		block->bytes = bytes;
+		block->next = *link;
+		*link = block;
+
+		pool->stats.retained_chunks++;
+		pool->stats.retained_bytes += bytes;
+		kept = true;
+	}
+	else {
+		pool->stats.dropped++;
+	}
+
+	pthread_mutex_unlock(&pool->guard);
+
+	return kept;
+}
@@ -0,0 +1,80 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+/*
+* Pool of freed vector chunks, reused when a vector grows again.
+* One pool may be shared by many vectors, see vector_attr_t 'pool'.
+*/
+
+typedef struct pool_stats_t
+{
+	size_t hits;			// chunks handed out from the pool
+	size_t misses;			// requests the pool could not serve, the vector allocated instead
+	size_t dropped;			// chunks freed because the pool was full
+	size_t retained_chunks;	// chunks in the pool now
+	size_t retained_bytes;
+} pool_stats_t;
+
+/**
+ * Create a pool that keeps up to `retain_bytes` of freed chunks.
+ *
+ * RETURN VALUES:
+ * pool_t pointer
+ * NULL pointer -- when failed to allocate memory
+ *
+ * [in] - retain_bytes
+ */
+pool_t* pool_create(size_t retain_bytes);
+
+/**
+ * Free the pool and every chunk in it. No vector may use it anymore.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS -- pool is destroyed
+ * VECTOR_FAILURE -- pool is invalid
+ *
+ * [in] - pool
+ */
+vector_ret_t pool_destroy(pool_t* pool);
+
+/**
+ * Get the pool counters.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- pool or p_stats is invalid
+ *
+ * [in] - pool
+ * [out] - p_stats
+ */
+vector_ret_t pool_get_stats(pool_t* pool, pool_stats_t* p_stats);
+
+/**
+ * Take the smallest chunk of at least `min_bytes` out of the pool. Used by vector.c.
+ *
+ * RETURN VALUES:
+ * memory pointer, `*p_bytes` is its size
+ * NULL pointer -- when no chunk is large enough
+ *
+ * [in] - pool, min_bytes
+ * [out] - p_bytes
+ */
+void* pool_get(pool_t* pool, size_t min_bytes, size_t* p_bytes);
+
+/**
+ * Keep a freed chunk of `bytes` for reuse. Used by vector.c.
+ *
+ * RETURN VALUES:
+ * true  -- the pool took the chunk
+ * false -- the pool is full, the caller frees the chunk
+ *
+ * [in] - pool, memory, bytes
+ */
+bool pool_put(pool_t* pool, void* memory, size_t bytes);
+
+#endif // POOL_H
@@ -0,0 +1,255 @@
+#ifndef MPMC_QUEUE_HPP
+#define MPMC_QUEUE_HPP
+
+extern "C"
+{
+#include "vector.h"
+}
+
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/*
+* Typed C++ front end of vector_t. Elements are stored inline in the chunk ring, no boxing.
+*
+* Trivially copyable T is copied in and out with the _copy functions, batches with one memcpy per run of cells.
+* Any other T is constructed straight in its cell with vector_reserve() / vector_commit(),
+* and moved out and destroyed in place with vector_peek_claim() / vector_release(),
+* so move-only types work and nothing is ever copied bytewise.
+*
+* Producers and Consumers are the thread counts when they are known at compile time,
+* the vector mode is picked from them:
+*   1 x 1, trivially copyable T   VECTOR_MODE_SPSC
+*   1 x N or N x 1                VECTOR_MODE_TWO_LOCK, the single thread never contends with its own side
+*   otherwise                     VECTOR_MODE_LOCKED
+*/
+namespace mpmc
+{
+	inline constexpr std::size_t dynamic = 0;
+
+	template <typename T, std::size_t Producers = dynamic, std::size_t Consumers = dynamic>
+	class queue
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t), "cells are aligned to max_align_t");
+		static_assert(std::is_nothrow_destructible_v<T>, "elements are destroyed by pops and by ~queue()");
+		static_assert(std::is_trivially_copyable_v<T> || std::is_nothrow_move_constructible_v<T>,
+					  "a reserved or claimed cell cannot be given back, moving into or out of it must not throw");
+
+	public:
+		using value_type = T;
+
+		static constexpr bool trivial = std::is_trivially_copyable_v<T>;
+
+		static constexpr vector_mode_t mode =
+			(Producers == 1 && Consumers == 1 && trivial) ? VECTOR_MODE_SPSC :
+			(Producers == 1 || Consumers == 1) ? VECTOR_MODE_TWO_LOCK :
+			VECTOR_MODE_LOCKED;
+
+		/**
+		 * Create the queue with room for `capacity` elements, it grows past that on demand.
+		 * `attr` tunes the vector, its mode and element size are set by the template.
+		 *
+		 * Throws std::bad_alloc when the vector cannot be created.
+		 */
+		explicit queue(std::size_t capacity = 0, vector_attr_t attr = {})
+		{
+			attr.mode = mode;
+			attr.element_size = sizeof(T);
+
+			if ((vector_ = vector_create_attr(capacity, &attr)) == nullptr)
+				throw std::bad_alloc();
+		}
+
+		// Elements still queued are destroyed, no other thread may use the queue anymore
+		~queue()
+		{
+			if constexpr (!std::is_trivially_destructible_v<T>) {
+				vector_slot_t slot;
+
+				while (vector_try_peek_claim(vector_, &slot) == VECTOR_SUCCESS) {
+					std::launder(static_cast<T*>(slot.element))->~T();
+					vector_release(vector_, &slot);
+				}
+			}
+
+			vector_destroy(vector_);
+		}
+
+		queue(const queue&) = delete;
+		queue& operator=(const queue&) = delete;
+
+		void push(const T& value) { emplace(value); }
+		void push(T&& value) { emplace(std::move(value)); }
+
+		/**
+		 * Construct an element from `args` at the tail.
+		 *
+		 * Throws std::bad_alloc when the vector cannot grow, or what the constructor of T throws.
+		 * Nothing is queued then.
+		 */
+		template <typename... Args>
+		void emplace(Args&&... args)
+		{
+			if constexpr (trivial) {
+				T value(std::forward<Args>(args)...);
+
+				check_push(vector_push_copy(vector_, &value));
+			}
+			else if constexpr (std::is_nothrow_constructible_v<T, Args...>) {
+				vector_slot_t slot;
+
+				check_push(vector_reserve(vector_, &slot));
+				::new (slot.element) T(std::forward<Args>(args)...);
+				check(vector_commit(vector_, &slot));
+			}
+			else {
+				// Construct first, nothing may throw between reserve and commit
+				T value(std::forward<Args>(args)...);
+				vector_slot_t slot;
+
+				check_push(vector_reserve(vector_, &slot));
+				::new (slot.element) T(std::move(value));
+				check(vector_commit(vector_, &slot));
+			}
+		}
+
+		// Remove the head element, wait while the queue is empty
+		T pop()
+		{
+			if constexpr (trivial) {
+				alignas(T) unsigned char storage[sizeof(T)];
+
+				check(vector_pop_copy(vector_, storage));
+				return *std::launder(reinterpret_cast<T*>(storage));
+			}
+			else {
+				vector_slot_t slot;
+
+				check(vector_peek_claim(vector_, &slot));
+				return take(slot);
+			}
+		}
+
+		// Remove the head element into `out`, false when the queue is empty
+		bool try_pop(T& out)
+		{
+			if constexpr (trivial) {
+				vector_ret_t ret = vector_try_pop_copy(vector_, &out);
+
+				if (ret == VECTOR_EMPTY)
+					return false;
+
+				check(ret);
+				return true;
+			}
+			else {
+				vector_slot_t slot;
+				vector_ret_t ret = vector_try_peek_claim(vector_, &slot);
+
+				if (ret == VECTOR_EMPTY)
+					return false;
+
+				check(ret);
+				out = take(slot);
+				return true;
+			}
+		}
+
+		// Remove the head element, nothing when the queue is empty
+		std::optional<T> try_pop()
+		{
+			if constexpr (trivial) {
+				alignas(T) unsigned char storage[sizeof(T)];
+				vector_ret_t ret = vector_try_pop_copy(vector_, storage);
+
+				if (ret == VECTOR_EMPTY)
+					return std::nullopt;
+
+				check(ret);
+				return *std::launder(reinterpret_cast<T*>(storage));
+			}
+			else {
+				vector_slot_t slot;
+				vector_ret_t ret = vector_try_peek_claim(vector_, &slot);
+
+				if (ret == VECTOR_EMPTY)
+					return std::nullopt;
+
+				check(ret);
+				return take(slot);
+			}
+		}
+
+		// Append `n` elements, in one lock acquisition when T is trivially copyable
+		void push_n(const T* values, std::size_t n)
+		{
+			if constexpr (trivial)
+				check_push(vector_push_n_copy(vector_, values, n));
+			else
+				for (std::size_t i = 0; i < n; i++)
+					emplace(values[i]);
+		}
+
+		/**
+		 * Remove up to `max` elements into `out`, wait while the queue is empty.
+		 * Returns how many were removed, at least one.
+		 */
+		std::size_t pop_n(T* out, std::size_t max)
+		{
+			if (max == 0)
+				return 0;
+
+			if constexpr (trivial) {
+				std::size_t popped = 0;
+
+				check(vector_pop_n_copy(vector_, out, max, &popped));
+				return popped;
+			}
+			else {
+				std::size_t popped = 1;
+
+				out[0] = pop();
+				while (popped < max && try_pop(out[popped]))
+					popped++;
+
+				return popped;
+			}
+		}
+
+		// The underlying vector, e.g. for vector_stats() or vector_get_fd()
+		vector_t* native_handle() const noexcept { return vector_; }
+
+	private:
+		// The vector fails a push only when it cannot grow
+		static void check_push(vector_ret_t ret)
+		{
+			if (ret != VECTOR_SUCCESS)
+				throw std::bad_alloc();
+		}
+
+		static void check(vector_ret_t ret)
+		{
+			if (ret != VECTOR_SUCCESS)
+				throw std::runtime_error("mpmc::queue: vector call failed");
+		}
+
+		T take(vector_slot_t& slot)
+		{
+			T* element = std::launder(static_cast<T*>(slot.element));
+			T value(std::move(*element));
+
+			element->~T();
+			vector_release(vector_, &slot);
+
+			return value;
+		}
+
+		vector_t* vector_;
+	};
+} // namespace mpmc
+
+#endif // MPMC_QUEUE_HPP
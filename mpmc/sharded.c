@@ -0,0 +1,220 @@
+/*
+* Sharded Vector.
+*
+* Every operation on a single vector touches the same head or tail cache
+* lines, which bounce between cores, and between sockets on large machines.
+* Spreading the traffic over one vector per CPU keeps most of it local:
+*
+*   CPU 0 producers -> |shard 0| -> CPU 0 consumers
+*   CPU 1 producers -> |shard 1| -> CPU 1 consumers
+*                          ...          ^ steal when the home shard is EMPTY
+*
+* A thread's home CPU is the CPU it ran on when it first used any sharded
+* vector, and it never changes. So a producer keeps pushing to one shard even
+* when the scheduler migrates it, which keeps its elements in order.
+*
+* Consumers poll shards with vector_try_pop(), which does not lock an EMPTY
+* vector, and sleep on a single 'avail' event when every shard is EMPTY.
+* Producers notify it with the light variant (see event.h), so a push
+* costs no memory fence while consumers are busy.
+*/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "sharded.h"
+#include "event.h"
+#include "cpu.h"
+#include "debug.h"
+
+#define CHECK_AND_RETURN_IF_NOT_EXIST(pointer_object)  \
+    do{                                                \
+        if (pointer_object == NULL)                    \
+        {                                              \
+            debug_print("Object does not exist\n");    \
+            return VECTOR_FAILURE;                     \
+        }                                              \
+    }while(0)
+
+struct sharded_t
+{
+	size_t shards;
+	vector_t** shard;
+	bool light_notify;			// producers notify with event_notify_light()
+
+	alignas(CACHE_LINE_SIZE) event_t avail;	// consumers sleep here while all shards are EMPTY
+};
+
+// Home CPU of the calling thread, -1 until its first operation
+static _Thread_local long sharded_home_cpu = -1;
+static atomic_ulong sharded_next_home;
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+sharded_t* sharded_create(size_t shards, size_t capacity, const vector_attr_t* attr);
+vector_ret_t sharded_destroy(sharded_t* sharded);
+
+vector_ret_t sharded_push(sharded_t* sharded, void* element);
+vector_ret_t sharded_pop(sharded_t* sharded, void** p_element);
+vector_ret_t sharded_try_pop(sharded_t* sharded, void** p_element);
+vector_ret_t sharded_get_shards(sharded_t* sharded, size_t* p_shards);
+
+static vector_ret_t sharded_scan(sharded_t* sharded, void** p_element);
+static inline size_t sharded_home(const sharded_t* sharded);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+sharded_t* sharded_create(size_t shards, size_t capacity, const vector_attr_t* attr)
+{
+	if (attr != NULL && attr->mode == VECTOR_MODE_SPSC) {
+		debug_print("Shards may have many producers, VECTOR_MODE_SPSC is not allowed\n");
+		return NULL;
+	}
+
+	if (shards == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		shards = (cpus > 0) ? (size_t)cpus : 1;
+	}
+
+	sharded_t* sharded = aligned_alloc(CACHE_LINE_SIZE, sizeof(*sharded));
+
+	if (sharded == NULL)
+		return NULL;
+
+	sharded->shard = calloc(shards, sizeof(sharded->shard[0]));
+
+	if (sharded->shard == NULL) {
+		free(sharded);
+		return NULL;
+	}
+
+	sharded->shards = shards;
+	sharded->light_notify = event_asymmetric_init();
+	event_init(&sharded->avail);
+
+	for (size_t idx = 0; idx < shards; idx++) {
+		sharded->shard[idx] = vector_create_attr(capacity, attr);
+
+		if (sharded->shard[idx] == NULL) {
+			debug_print("Could not create shard: %zu\n", idx);
+			sharded_destroy(sharded);
+			return NULL;
+		}
+	}
+
+	return sharded;
+}
+
+vector_ret_t sharded_destroy(sharded_t* sharded)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(sharded);
+
+	for (size_t idx = 0; idx < sharded->shards; idx++) {
+		if (sharded->shard[idx] != NULL)
+			vector_destroy(sharded->shard[idx]);
+	}
+
+	free(sharded->shard);
+	free(sharded);
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t sharded_push(sharded_t* sharded, void* element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(sharded);
+
+	if (vector_push(sharded->shard[sharded_home(sharded)], element) != VECTOR_SUCCESS)
+		return VECTOR_FAILURE;
+
+	if (sharded->light_notify) {
+		event_notify_light(&sharded->avail, 1);
+	}
+	else {
+		atomic_thread_fence(memory_order_seq_cst);
+		event_notify(&sharded->avail, 1);
+	}
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t sharded_pop(sharded_t* sharded, void** p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(sharded);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	for (;;) {
+		vector_ret_t ret = sharded_scan(sharded, p_element);
+
+		if (ret != VECTOR_EMPTY)
+			return ret;
+
+		// All shards are EMPTY, look once more after registering as a sleeper
+		uint32_t key = sharded->light_notify ? event_prepare_wait_heavy(&sharded->avail) :
+											   event_prepare_wait(&sharded->avail);
+
+		ret = sharded_scan(sharded, p_element);
+
+		if (ret != VECTOR_EMPTY) {
+			event_cancel_wait(&sharded->avail);
+			return ret;
+		}
+
+		event_wait(&sharded->avail, key, NULL);
+	}
+}
+
+vector_ret_t sharded_try_pop(sharded_t* sharded, void** p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(sharded);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	return sharded_scan(sharded, p_element);
+}
+
+vector_ret_t sharded_get_shards(sharded_t* sharded, size_t* p_shards)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(sharded);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_shards);
+
+	*p_shards = sharded->shards;
+
+	return VECTOR_SUCCESS;
+}
+
+// Home shard first, then every other shard once, starting with the next one
+static vector_ret_t sharded_scan(sharded_t* sharded, void** p_element)
+{
+	size_t home = sharded_home(sharded);
+
+	for (size_t step = 0; step < sharded->shards; step++) {
+		size_t idx = (home + step) % sharded->shards;
+		vector_ret_t ret = vector_try_pop(sharded->shard[idx], p_element);
+
+		if (ret != VECTOR_EMPTY)
+			return ret;
+	}
+
+	return VECTOR_EMPTY;
+}
+
+static inline size_t sharded_home(const sharded_t* sharded)
+{
+	if (sharded_home_cpu < 0) {
+		int cpu = sched_getcpu();
+
+		// Without sched_getcpu() threads are spread over the shards in turn
+		sharded_home_cpu = (cpu >= 0) ? cpu : (long)atomic_fetch_add(&sharded_next_home, 1);
+	}
+
+	return (size_t)sharded_home_cpu % sharded->shards;
+}
@@ -0,0 +1,90 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include <stddef.h>
+
+#include "vector.h"
+
+/*
+* Sharded front-end over several vectors, one per CPU by default.
+*
+* A producer pushes to the shard of its home CPU, a consumer pops from its
+* home shard first and steals from the others when it is EMPTY.
+* Elements of one producer keep their order, elements of different
+* producers may be popped in any order.
+*/
+typedef struct sharded_t sharded_t;
+
+/**
+ * Create `shards` vectors of `capacity` elements each, using the given attributes.
+ * VECTOR_MODE_SPSC is not allowed, a shard may have many producers.
+ *
+ * RETURN VALUES:
+ * sharded_t pointer
+ * NULL pointer -- when failed to allocate memory or attributes are invalid
+ *
+ * [in] - shards (0 for one per online CPU), capacity, attr (NULL for defaults)
+ */
+sharded_t* sharded_create(size_t shards, size_t capacity, const vector_attr_t* attr);
+
+/**
+ * Destroy all shards.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS -- sharded vector is destroyed
+ * VECTOR_FAILURE -- sharded vector is invalid
+ *
+ * [in] - sharded
+ */
+vector_ret_t sharded_destroy(sharded_t* sharded);
+
+/**
+ * Add an element to the shard of the calling thread's home CPU.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- sharded is invalid, or malloc failed when enlarging the shard
+ *
+ * [in] - sharded, element
+ */
+vector_ret_t sharded_push(sharded_t* sharded, void* element);
+
+/**
+ * Remove an element from the home shard, or steal one from another shard.
+ * Block the thread, when all shards are empty, waiting for new data.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- sharded or p_element is invalid
+ *
+ * [in] - sharded
+ * [out] - p_element
+ */
+vector_ret_t sharded_pop(sharded_t* sharded, void** p_element);
+
+/**
+ * Same as sharded_pop(), but never blocks.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_EMPTY -- all shards are empty, p_element is untouched
+ * VECTOR_FAILURE -- sharded or p_element is invalid
+ *
+ * [in] - sharded
+ * [out] - p_element
+ */
+vector_ret_t sharded_try_pop(sharded_t* sharded, void** p_element);
+
+/**
+ * Get the number of shards.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- sharded or p_shards is invalid
+ *
+ * [in] - sharded
+ * [out] - p_shards
+ */
+vector_ret_t sharded_get_shards(sharded_t* sharded, size_t* p_shards);
+
+#endif // SHARDED_H
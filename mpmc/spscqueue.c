@@ -0,0 +1,216 @@
+/*
+* Unbounded Single-Producer Single-Consumer Queue.
+*
+* The queue is a linked list of ring segments, sizes are powers of two
+* and every segment is twice as large as the previous one:
+*
+*   head                  tail
+*    |                     |
+*   |.|3|4|.| -> |5|6|7|8|9|10|.|.| -> NULL
+*      | |          |       |
+*   head tail      head    tail
+*
+* Each index has a single writer: 'tail' the producer, 'head' the consumer.
+* They are published with release stores and read with acquire loads,
+* so the steady state needs no atomic read-modify-write at all.
+*
+* Each side also keeps a private copy of the other side's index and reads
+* the shared one only when its copy says the ring is FULL (producer)
+* or EMPTY (consumer), so the index cache lines rarely move between cores.
+*
+* A FULL segment is never waited on: the producer links a new one and
+* never comes back. A consumer that drained a segment with a successor
+* frees it and moves on.
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "spscqueue.h"
+#include "cpu.h"
+#include "debug.h"
+
+typedef struct spscq_segment_t spscq_segment_t;
+
+struct spscq_segment_t
+{
+	alignas(CACHE_LINE_SIZE) atomic_size_t head;	// written by the consumer
+	size_t cached_tail;								// consumer's copy of 'tail'
+
+	alignas(CACHE_LINE_SIZE) atomic_size_t tail;	// written by the producer
+	size_t cached_head;								// producer's copy of 'head'
+
+	alignas(CACHE_LINE_SIZE) _Atomic(spscq_segment_t*) next;
+	size_t mask;									// segment size - 1
+
+	alignas(max_align_t) unsigned char cell[];
+};
+
+struct spscqueue_t
+{
+	alignas(CACHE_LINE_SIZE) spscq_segment_t* head;	// consumer only
+	size_t element_size;
+
+	alignas(CACHE_LINE_SIZE) spscq_segment_t* tail;	// producer only
+};
+
+/*
+* FUNCTION DECLARATIONS
+*/
+
+spscqueue_t* spscqueue_create(size_t segment_size, size_t element_size);
+void spscqueue_destroy(spscqueue_t* queue);
+
+vector_ret_t spscqueue_enqueue(spscqueue_t* queue, const void* p_element);
+bool spscqueue_dequeue(spscqueue_t* queue, void* p_element);
+
+static spscq_segment_t* spscq_segment_create(size_t size, size_t element_size);
+static inline void spscq_copy(void* dst, const void* src, size_t element_size);
+
+/*
+* FUNCTION DEFINITIONS
+*/
+
+spscqueue_t* spscqueue_create(size_t segment_size, size_t element_size)
+{
+	spscqueue_t* queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(*queue));
+
+	if (queue == NULL)
+		return NULL;
+
+	// Round up to a power of two, so an index maps to a cell with a mask
+	size_t size = 1;
+
+	while (size < segment_size && size <= SIZE_MAX / 4)
+		size *= 2;
+
+	queue->element_size = element_size;
+	queue->head = queue->tail = spscq_segment_create(size, element_size);
+
+	if (queue->head == NULL) {
+		debug_print("Not enough memory for segment size: %zu\n", size);
+		free(queue);
+		return NULL;
+	}
+
+	return queue;
+}
+
+void spscqueue_destroy(spscqueue_t* queue)
+{
+	spscq_segment_t* segment = queue->head;
+
+	while (segment != NULL) {
+		spscq_segment_t* next = atomic_load(&segment->next);
+		free(segment);
+		segment = next;
+	}
+
+	free(queue);
+}
+
+vector_ret_t spscqueue_enqueue(spscqueue_t* queue, const void* p_element)
+{
+	spscq_segment_t* segment = queue->tail;
+	size_t tail = atomic_load_explicit(&segment->tail, memory_order_relaxed);
+
+	if (tail - segment->cached_head > segment->mask) {
+		segment->cached_head = atomic_load_explicit(&segment->head, memory_order_acquire);
+
+		if (tail - segment->cached_head > segment->mask) {
+			// Segment is FULL, continue in a twice larger one
+			size_t size = (segment->mask + 1 <= SIZE_MAX / 4) ? 2 * (segment->mask + 1) : segment->mask + 1;
+			spscq_segment_t* next = spscq_segment_create(size, queue->element_size);
+
+			if (next == NULL) {
+				debug_print("Not enough memory for segment size: %zu\n", size);
+				return VECTOR_FAILURE;
+			}
+
+			spscq_copy(next->cell, p_element, queue->element_size);
+			atomic_store_explicit(&next->tail, 1, memory_order_relaxed);
+
+			// Publishes the element too, and 'tail' of this segment is final from now on
+			atomic_store_explicit(&segment->next, next, memory_order_release);
+			queue->tail = next;
+
+			return VECTOR_SUCCESS;
+		}
+	}
+
+	spscq_copy(segment->cell + (tail & segment->mask) * queue->element_size, p_element, queue->element_size);
+	atomic_store_explicit(&segment->tail, tail + 1, memory_order_release);
+
+	return VECTOR_SUCCESS;
+}
+
+bool spscqueue_dequeue(spscqueue_t* queue, void* p_element)
+{
+	for (;;) {
+		spscq_segment_t* segment = queue->head;
+		size_t head = atomic_load_explicit(&segment->head, memory_order_relaxed);
+
+		if (head == segment->cached_tail) {
+			segment->cached_tail = atomic_load_explicit(&segment->tail, memory_order_acquire);
+
+			if (head == segment->cached_tail) {
+				spscq_segment_t* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+
+				if (next == NULL)
+					return false;	// queue is EMPTY
+
+				// Producer left this segment for good, look at its final 'tail'
+				segment->cached_tail = atomic_load_explicit(&segment->tail, memory_order_acquire);
+
+				if (head == segment->cached_tail) {
+					queue->head = next;
+					free(segment);
+				}
+
+				continue;
+			}
+		}
+
+		spscq_copy(p_element, segment->cell + (head & segment->mask) * queue->element_size, queue->element_size);
+		atomic_store_explicit(&segment->head, head + 1, memory_order_release);
+
+		return true;
+	}
+}
+
+static spscq_segment_t* spscq_segment_create(size_t size, size_t element_size)
+{
+	if (size > (SIZE_MAX - sizeof(spscq_segment_t) - CACHE_LINE_SIZE) / element_size)
+		return NULL;
+
+	size_t bytes = sizeof(spscq_segment_t) + size * element_size;
+
+	// aligned_alloc() requires size to be a multiple of the alignment
+	bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+	spscq_segment_t* segment = aligned_alloc(CACHE_LINE_SIZE, bytes);
+
+	if (segment == NULL)
+		return NULL;
+
+	atomic_init(&segment->head, 0);
+	atomic_init(&segment->tail, 0);
+	atomic_init(&segment->next, NULL);
+	segment->cached_tail = 0;
+	segment->cached_head = 0;
+	segment->mask = size - 1;
+
+	return segment;
+}
+
+static inline void spscq_copy(void* dst, const void* src, size_t element_size)
+{
+	// A pointer is the common case, a constant size lets the compiler inline the copy
+	if (element_size == sizeof(void*))
+		memcpy(dst, src, sizeof(void*));
+	else
+		memcpy(dst, src, element_size);
+}
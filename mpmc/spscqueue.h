@@ -0,0 +1,58 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "vector.h"
+
+/*
+* Unbounded single-producer single-consumer queue used by VECTOR_MODE_SPSC.
+* At most one thread enqueues and one thread dequeues at a time.
+* It never blocks: waiting for data is done by the vector layer.
+*/
+typedef struct spscqueue_t spscqueue_t;
+
+/**
+ * Create a queue whose first segment holds at least `segment_size` elements
+ * of `element_size` bytes. Every next segment is twice as large.
+ *
+ * RETURN VALUES:
+ * spscqueue_t pointer
+ * NULL pointer -- when failed to allocate memory
+ *
+ * [in] - segment_size, element_size
+ */
+spscqueue_t* spscqueue_create(size_t segment_size, size_t element_size);
+
+/**
+ * Destroy the queue. No other thread may use it anymore.
+ *
+ * [in] - queue
+ */
+void spscqueue_destroy(spscqueue_t* queue);
+
+/**
+ * Copy an element to the tail of the queue. Producer thread only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- malloc failed when linking a new segment
+ *
+ * [in] - queue, p_element
+ */
+vector_ret_t spscqueue_enqueue(spscqueue_t* queue, const void* p_element);
+
+/**
+ * Copy an element from the head of the queue and remove it. Consumer thread only.
+ *
+ * RETURN VALUES:
+ * true  -- element was removed
+ * false -- queue is empty
+ *
+ * [in] - queue
+ * [out] - p_element
+ */
+bool spscqueue_dequeue(spscqueue_t* queue, void* p_element);
+
+#endif // SPSCQUEUE_H
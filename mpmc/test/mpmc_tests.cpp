@@ -1,13 +1,27 @@
 extern "C" {
 #include "../vector.h"
+#include "../sharded.h"
+#include "../pool.h"
 }
 
+#include "../queue.hpp"
+#include "../async_queue.hpp"
+#include "../benchmark/schedulers.h"
+
 #include "gtest/gtest.h"
 #include <thread>
+#include <memory>
+#include <string>
+#include <atomic>
 #include <vector>
+#include <tuple>
 #include <algorithm>
 #include <numeric>
 #include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/epoll.h>
 
 typedef struct
 {
@@ -17,9 +31,14 @@ typedef struct
 	size_t consumers_n;
 	size_t producer_sleep;
 	size_t consumer_sleep;
+	vector_mode_t vector_mode;
+	vector_wait_t vector_wait;
+	vector_lock_t vector_lock;
+	bool elimination;
 } mpmc_sim_opt_t;
 
 void mpmc_simulate(mpmc_sim_opt_t options);
+void fifo_per_producer_simulate(vector_mode_t mode, size_t producers_n, size_t consumers_n, bool elimination = false);
 
 /* Call functions with invalid(NULL) pointers*/
 TEST(BASIC_OP, NULL_INPUT_TEST) {
@@ -174,6 +193,131 @@ TEST(BASIC_OP, Circulation_Overflow)
 	vector_destroy(vector);
 }
 
+/*
+* Vector grows while elements sit in several chunks, the order must be preserved
+*/
+TEST(BASIC_OP, Interleaved_Growth)
+{
+	vector_t* vector = vector_create(3);
+
+	void* data_ptr = nullptr;
+	size_t pushed = 0;
+	size_t popped = 0;
+
+	for (size_t round = 0; round < 1000; round++) {
+		for (size_t i = 0; i < 3; i++) {
+			ASSERT_EQ(vector_push(vector, (void*)pushed++), VECTOR_SUCCESS);
+		}
+
+		for (size_t i = 0; i < 2; i++) {
+			ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+			ASSERT_EQ((size_t)data_ptr, popped++);
+		}
+	}
+
+	while (popped < pushed) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, popped++);
+	}
+
+	vector_destroy(vector);
+}
+
+TEST(BATCH_OP, NULL_INPUT_TEST)
+{
+	vector_t* vector = vector_create(5);
+
+	void* elements[2] = { nullptr, nullptr };
+	size_t popped = 0;
+
+	EXPECT_EQ(vector_push_n(nullptr, elements, 2), VECTOR_FAILURE);
+	EXPECT_EQ(vector_push_n(vector, nullptr, 2), VECTOR_FAILURE);
+	EXPECT_EQ(vector_push_n(vector, elements, 0), VECTOR_SUCCESS);
+
+	EXPECT_EQ(vector_pop_n(nullptr, elements, 2, &popped), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_n(vector, nullptr, 2, &popped), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_n(vector, elements, 2, nullptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_n(vector, elements, 0, &popped), VECTOR_SUCCESS);
+	EXPECT_EQ(popped, 0);
+
+	vector_destroy(vector);
+}
+
+/*
+* Batches larger than the vector, crossing chunk boundaries both ways
+*/
+void batch_push_pop(vector_mode_t mode)
+{
+	vector_attr_t attr = { .mode = mode };
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	void* in[100];
+	void* out[100];
+	size_t popped = 0;
+	size_t next_expected = 0;
+
+	for (size_t i = 0; i < 100; i++) {
+		in[i] = (void*)i;
+	}
+
+	ASSERT_EQ(vector_push_n(vector, in, 3), VECTOR_SUCCESS);
+	ASSERT_EQ(vector_push_n(vector, in + 3, 97), VECTOR_SUCCESS);
+
+	while (next_expected < 100) {
+		ASSERT_EQ(vector_pop_n(vector, out, 7, &popped), VECTOR_SUCCESS);
+		ASSERT_GT(popped, 0);
+		ASSERT_LE(popped, 7);
+
+		for (size_t i = 0; i < popped; i++) {
+			ASSERT_EQ((size_t)out[i], next_expected++);
+		}
+	}
+
+	vector_destroy(vector);
+}
+
+TEST(BATCH_OP, Push_Pop)
+{
+	batch_push_pop(VECTOR_MODE_LOCKED);
+}
+
+TEST(BATCH_OP, Push_Pop_Lockfree)
+{
+	batch_push_pop(VECTOR_MODE_LOCKFREE);
+}
+
+TEST(BATCH_OP, Push_Pop_Two_Lock)
+{
+	batch_push_pop(VECTOR_MODE_TWO_LOCK);
+}
+
+/*
+* One batch must wake every consumer that can get an element from it
+*/
+TEST(BATCH_OP, Batch_Wakes_All_Consumers)
+{
+	const size_t consumers_n = 4;
+
+	vector_t* vector = vector_create(1);
+	std::vector<std::thread> consumers;
+
+	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
+		consumers.push_back(std::thread([=]() {
+			void* data_ptr = nullptr;
+			EXPECT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		}));
+	}
+
+	sleep(1);
+
+	void* elements[consumers_n] = { nullptr, nullptr, nullptr, nullptr };
+	EXPECT_EQ(vector_push_n(vector, elements, consumers_n), VECTOR_SUCCESS);
+
+	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t) { t.join(); });
+
+	vector_destroy(vector);
+}
+
 TEST(SPSC, Push_Pop)
 {
 	mpmc_simulate(mpmc_sim_opt_t {
@@ -318,96 +462,1752 @@ TEST(MPMC, FullVector_Overflow)
 	});
 }
 
-// Recursive function to return gcd of a and b
-long long gcd(long long int a, long long int b)
+TEST(LOCKFREE, NULL_INPUT_TEST)
 {
-	if (b == 0)
-		return a;
-	return gcd(b, a % b);
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKFREE };
+	vector_t* vector = vector_create_attr(5, &attr);
+
+	void* data_ptr = &data_ptr;
+
+	EXPECT_EQ(vector_push(vector, nullptr), VECTOR_SUCCESS); // NULL is a valid value
+	EXPECT_EQ(vector_pop(vector, nullptr), VECTOR_FAILURE);
+
+	EXPECT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+	EXPECT_EQ(data_ptr, nullptr);
+
+	vector_destroy(vector);
 }
 
-// Function to return LCM of two numbers
-long long lcm(int a, int b)
+/*
+* Elements must survive crossing many segment boundaries
+*/
+TEST(LOCKFREE, ZeroCapacity_Overflow)
 {
-	return (a / gcd(a, b)) * b;
+	const size_t num_of_data = 10000;
+
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKFREE };
+	vector_t* vector = vector_create_attr(0, &attr);
+	void* data_ptr = nullptr;
+
+	for (size_t data_n = 0; data_n < num_of_data; data_n++) {
+		ASSERT_EQ(vector_push(vector, (void*)data_n), VECTOR_SUCCESS);
+	}
+
+	for (size_t data_n = 0; data_n < num_of_data; data_n++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, data_n);
+	}
+
+	vector_destroy(vector);
 }
 
-int my_accumulate(int* result, size_t n) {
-	return std::accumulate(result, result + n, 0);
+TEST(LOCKFREE, SPMC_Pop_Block_Push)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 20,
+			.data_amount = 20,
+			.producers_n = 1,
+			.consumers_n = 5,
+			.producer_sleep = 1,
+			.consumer_sleep = 0,
+			.vector_mode = VECTOR_MODE_LOCKFREE
+	});
 }
 
-void mpmc_simulate(mpmc_sim_opt_t options)
+TEST(LOCKFREE, MPMC_FullVector_Overflow)
 {
-	size_t vector_size = options.vector_size;
-	size_t data_amount = options.data_amount;
-	size_t producers_n = options.producers_n; 
-	size_t consumers_n = options.consumers_n;
-	size_t producer_sleep = options.producer_sleep;
-	size_t consumer_sleep = options.consumer_sleep;
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 10,
+			.data_amount = 20000,
+			.producers_n = 5,
+			.consumers_n = 5,
+			.producer_sleep = 0,
+			.consumer_sleep = 0,
+			.vector_mode = VECTOR_MODE_LOCKFREE
+	});
+}
 
-	// we need to be sure that data_amount is divisible by both producers_n and consumers_n
-	long long alignment = lcm(producers_n, consumers_n);
-	if (data_amount % alignment != 0) {
-		data_amount += (alignment - data_amount % alignment);
+TEST(WAIT, Invalid_Strategy)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKED, .wait = (vector_wait_t)42 };
+
+	EXPECT_EQ(vector_create_attr(5, &attr), nullptr);
+}
+
+/*
+* Consumers start first and have to wait, with every strategy in both modes
+*/
+class WAIT_STRATEGY : public ::testing::TestWithParam<std::tuple<vector_mode_t, vector_wait_t>> {};
+
+TEST_P(WAIT_STRATEGY, MPMC_Pop_Block_Push)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 4,
+			.data_amount = 2000,
+			.producers_n = 2,
+			.consumers_n = 2,
+			.producer_sleep = 1,
+			.consumer_sleep = 0,
+			.vector_mode = std::get<0>(GetParam()),
+			.vector_wait = std::get<1>(GetParam())
+	});
+}
+
+INSTANTIATE_TEST_SUITE_P(WAIT, WAIT_STRATEGY, ::testing::Combine(
+	::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_LOCKFREE, VECTOR_MODE_TWO_LOCK),
+	::testing::Values(VECTOR_WAIT_PARK, VECTOR_WAIT_SPIN, VECTOR_WAIT_YIELD, VECTOR_WAIT_ADAPTIVE)));
+
+class TIMED_POP : public ::testing::TestWithParam<vector_mode_t> {};
+
+static struct timespec deadline_after_ms(long ms)
+{
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (ms % 1000) * 1000000;
+
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
 	}
 
-	vector_t* vector = vector_create(vector_size);
+	return deadline;
+}
 
-	// consumers_result[i] -- the data popped by consumer 'i'
-	int* consumers_result = new int[consumers_n];
-	memset(consumers_result, 0, consumers_n * sizeof(int));
+TEST_P(TIMED_POP, Try_Pop)
+{
+	vector_attr_t attr = { .mode = GetParam() };
+	vector_t* vector = vector_create_attr(2, &attr);
 
-	// producers_result[i] -- the data pushed by producer 'i'
-	int* producers_result = new int[producers_n];
-	memset(producers_result, 0, producers_n * sizeof(int));
+	int val = 0;
+	void* data_ptr = &data_ptr;
 
-	// Vector contains thread IDs
-	std::vector<std::thread> producers;
-	std::vector<std::thread> consumers;
+	EXPECT_EQ(vector_try_pop(nullptr, &data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_try_pop(vector, nullptr), VECTOR_FAILURE);
 
-	// create producers_n amount of producer threads
-	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
-		producers.push_back(std::thread([=, &producers_result]() {
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
+	EXPECT_EQ(data_ptr, &data_ptr);
 
-			sleep(producer_sleep);
+	EXPECT_EQ(vector_push(vector, &val), VECTOR_SUCCESS);
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_SUCCESS);
+	EXPECT_EQ(data_ptr, &val);
 
-		for (size_t iter = 0; iter < (unsigned int)((double)data_amount / (double)producers_n); iter++) {
-			EXPECT_EQ(vector_push(vector, (void*)(thread_n * iter)), VECTOR_SUCCESS);
-			producers_result[thread_n] += (int)(thread_n * iter);
-		}
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
 
-			})
-		);
+	vector_destroy(vector);
+}
+
+TEST_P(TIMED_POP, Pop_Until_Timeout)
+{
+	vector_attr_t attr = { .mode = GetParam() };
+	vector_t* vector = vector_create_attr(2, &attr);
+
+	void* data_ptr = nullptr;
+	struct timespec deadline = deadline_after_ms(50);
+	struct timespec now;
+
+	EXPECT_EQ(vector_pop_until(vector, &data_ptr, nullptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_until(vector, &data_ptr, &deadline), VECTOR_TIMEOUT);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	EXPECT_TRUE(now.tv_sec > deadline.tv_sec || 
+				(now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec));
+
+	vector_destroy(vector);
+}
+
+TEST_P(TIMED_POP, Pop_Until_Push)
+{
+	vector_attr_t attr = { .mode = GetParam() };
+	vector_t* vector = vector_create_attr(2, &attr);
+
+	int val = 0;
+	void* data_ptr = nullptr;
+	struct timespec deadline = deadline_after_ms(10000);
+
+	std::thread producer([&]() {
+		usleep(50000);
+		EXPECT_EQ(vector_push(vector, &val), VECTOR_SUCCESS);
+	});
+
+	EXPECT_EQ(vector_pop_until(vector, &data_ptr, &deadline), VECTOR_SUCCESS);
+	EXPECT_EQ(data_ptr, &val);
+
+	producer.join();
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, TIMED_POP, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_LOCKFREE, VECTOR_MODE_TWO_LOCK,
+														 VECTOR_MODE_SPSC));
+
+TEST(CAPACITY, Invalid_Policy)
+{
+	vector_attr_t attr = {};
+
+	attr.growth_factor = 0.5;
+	EXPECT_EQ(vector_create_attr(5, &attr), nullptr);
+
+	attr.growth_factor = 0;
+	attr.shrink_threshold = 1.5;
+	EXPECT_EQ(vector_create_attr(5, &attr), nullptr);
+}
+
+TEST(CAPACITY, Growth_Factor_And_Step)
+{
+	vector_attr_t attr = {};
+	attr.growth_factor = 1.5;
+	attr.max_growth_step = 5;
+
+	vector_t* vector = vector_create_attr(8, &attr);
+	size_t capacity = 0;
+
+	for (size_t i = 0; i < 9; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
 	}
 
-	// create consumers_n amount of consumer threads
-	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
-		consumers.push_back(std::thread([=, &consumers_result]() {
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_EQ(capacity, 12);	// 8 * 1.5
 
-			void* data_ptr = nullptr;
+	for (size_t i = 9; i < 13; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
 
-		sleep(consumer_sleep);
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_EQ(capacity, 17);	// 12 * 1.5, but step is limited to 5
 
-		for (size_t iter = 0; iter < (unsigned int)((double)data_amount / (double)consumers_n); iter++) {
-			EXPECT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
-			consumers_result[thread_n] += (intptr_t) data_ptr;
-		}
+	for (size_t i = 13; i < 19; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
 
-			})
-		);
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_EQ(capacity, 22);
+
+	vector_destroy(vector);
+}
+
+/*
+* After a spike the vector gives memory back, but never below its created capacity
+*/
+TEST(CAPACITY, Shrink_After_Spike)
+{
+	vector_attr_t attr = {};
+	attr.shrink_threshold = 0.25;
+	attr.shrink_delay = 16;
+
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	void* data_ptr = nullptr;
+	size_t capacity = 0;
+	size_t high_watermark = 0;
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
 	}
 
-	// Join producers
-	std::for_each(producers.begin(), producers.end(), [](std::thread& t1) { t1.join(); });
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
 
-	// Join consumers
-	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t2) { t2.join(); });
+	ASSERT_EQ(vector_get_high_watermark(vector, &high_watermark), VECTOR_SUCCESS);
+	EXPECT_EQ(high_watermark, 1000);
+
+	// Low traffic afterwards
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_GE(capacity, 4);
+	EXPECT_LT(capacity, 64);
 
 	vector_destroy(vector);
+}
 
-	// Compare the sum of pushed and popped data
-	EXPECT_EQ(my_accumulate(producers_result, producers_n), my_accumulate(consumers_result, consumers_n));
+TEST(CAPACITY, Presize)
+{
+	vector_attr_t attr = {};
+	attr.shrink_threshold = 0.5;
+	attr.shrink_delay = 1;
 
-	delete[] producers_result;
-	delete[] consumers_result;
-}
\ No newline at end of file
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	void* data_ptr = nullptr;
+	size_t capacity = 0;
+
+	ASSERT_EQ(vector_presize(vector, 100), VECTOR_SUCCESS);
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_EQ(capacity, 100);
+
+	// No growth up to the pre-sized capacity, and no shrinking below it
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
+
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_EQ(capacity, 100);
+
+	vector_destroy(vector);
+}
+
+/*
+* Chunks come from the reserved range first, then from malloc() once it is used up,
+* and the range is reused after shrinking
+*/
+TEST(CAPACITY, Reserved_Address_Space)
+{
+	vector_attr_t attr = {};
+	attr.reserve_bytes = 64 << 10;
+	attr.shrink_threshold = 0.25;
+	attr.shrink_delay = 16;
+
+	vector_attr_t lockfree_attr = { .mode = VECTOR_MODE_LOCKFREE, .reserve_bytes = 64 << 10 };
+	EXPECT_EQ(vector_create_attr(4, &lockfree_attr), nullptr);
+
+	for (bool huge_pages : { false, true }) {
+		attr.huge_pages = huge_pages;
+		vector_t* vector = vector_create_attr(4, &attr);
+		ASSERT_NE(vector, nullptr);
+
+		void* data_ptr = nullptr;
+		size_t capacity = 0;
+
+		for (size_t lap = 0; lap < 3; lap++) {
+			for (size_t i = 0; i < 100000; i++) {
+				ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+			}
+
+			for (size_t i = 0; i < 100000; i++) {
+				ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+				ASSERT_EQ((size_t)data_ptr, i);
+			}
+
+			for (size_t i = 0; i < 1000; i++) {
+				ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+				ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+			}
+		}
+
+		ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+		EXPECT_LT(capacity, 64);
+
+		vector_destroy(vector);
+	}
+}
+
+static void spike_and_settle(vector_t* vector, size_t spike)
+{
+	void* data_ptr = nullptr;
+
+	for (size_t i = 0; i < spike; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
+
+	for (size_t i = 0; i < spike; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	// Low traffic shrinks the vector back
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+	}
+}
+
+/*
+* Growing back to a size the vector had before reuses the pooled chunks
+*/
+TEST(POOL, Steady_State)
+{
+	vector_attr_t attr = {};
+	attr.shrink_threshold = 0.25;
+	attr.shrink_delay = 16;
+	attr.pool_retain_bytes = 1 << 20;
+
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	size_t allocations = 0;
+	size_t steady_allocations = 0;
+	size_t capacity = 0;
+
+	spike_and_settle(vector, 1000);
+
+	ASSERT_EQ(vector_get_allocations(vector, &allocations), VECTOR_SUCCESS);
+	EXPECT_GT(allocations, 1);
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_LT(capacity, 64);
+
+	for (size_t lap = 0; lap < 5; lap++)
+		spike_and_settle(vector, 1000);
+
+	ASSERT_EQ(vector_get_allocations(vector, &steady_allocations), VECTOR_SUCCESS);
+	EXPECT_EQ(steady_allocations, allocations);
+
+	vector_destroy(vector);
+}
+
+/*
+* Chunks freed by one vector are reused by another one, up to the retention limit
+*/
+TEST(POOL, Shared)
+{
+	EXPECT_EQ(pool_destroy(nullptr), VECTOR_FAILURE);
+
+	pool_t* pool = pool_create(1 << 20);
+	ASSERT_NE(pool, nullptr);
+
+	vector_attr_t attr = {};
+	attr.shrink_threshold = 0.25;
+	attr.shrink_delay = 16;
+	attr.pool = pool;
+
+	vector_t* first = vector_create_attr(4, &attr);
+	vector_t* second = vector_create_attr(4, &attr);
+
+	pool_stats_t stats = {};
+	size_t allocations = 0;
+
+	spike_and_settle(first, 1000);
+
+	ASSERT_EQ(pool_get_stats(pool, &stats), VECTOR_SUCCESS);
+	EXPECT_GT(stats.retained_chunks, 0);
+	EXPECT_EQ(stats.hits, 0);
+
+	spike_and_settle(second, 1000);
+
+	ASSERT_EQ(vector_get_allocations(second, &allocations), VECTOR_SUCCESS);
+	EXPECT_EQ(allocations, 1);		// only the chunk it was created with
+
+	ASSERT_EQ(pool_get_stats(pool, &stats), VECTOR_SUCCESS);
+	EXPECT_GT(stats.hits, 0);
+	EXPECT_EQ(stats.dropped, 0);
+
+	vector_destroy(first);
+	vector_destroy(second);
+
+	// A pool keeps at most 'retain_bytes', chunks a vector gives back past that are dropped
+	pool_t* small_pool = pool_create(256);
+	attr.pool = small_pool;
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	spike_and_settle(vector, 1000);
+
+	ASSERT_EQ(pool_get_stats(small_pool, &stats), VECTOR_SUCCESS);
+	EXPECT_GT(stats.dropped, 0);
+	EXPECT_LE(stats.retained_bytes, 256);
+
+	vector_destroy(vector);
+	EXPECT_EQ(pool_destroy(small_pool), VECTOR_SUCCESS);
+	EXPECT_EQ(pool_destroy(pool), VECTOR_SUCCESS);
+}
+
+/*
+* A pooled chunk larger than a vector needs goes back to the pool whole,
+* even when its bytes are not a multiple of the vector's cell size
+*/
+TEST(POOL, Shared_Between_Cell_Sizes)
+{
+	pool_t* pool = pool_create(1 << 20);
+	pool_stats_t before = {}, after = {};
+
+	vector_attr_t attr = { .element_size = 8, .pool = pool };
+	vector_destroy(vector_create_attr(100, &attr));
+	ASSERT_EQ(pool_get_stats(pool, &before), VECTOR_SUCCESS);
+
+	attr.element_size = 48;
+	vector_t* vector = vector_create_attr(10, &attr);
+	vector_destroy(vector);
+	ASSERT_EQ(pool_get_stats(pool, &after), VECTOR_SUCCESS);
+
+	EXPECT_EQ(after.hits, 1);
+	EXPECT_EQ(after.retained_chunks, before.retained_chunks);
+	EXPECT_EQ(after.retained_bytes, before.retained_bytes);
+
+	EXPECT_EQ(pool_destroy(pool), VECTOR_SUCCESS);
+}
+
+TEST(MPMC, FIFO_Per_Producer)
+{
+	fifo_per_producer_simulate(VECTOR_MODE_LOCKED, 4, 4);
+}
+
+TEST(LOCKFREE, FIFO_Per_Producer)
+{
+	fifo_per_producer_simulate(VECTOR_MODE_LOCKFREE, 4, 4);
+}
+
+/*
+* Producer and consumer take turns on a one-cell vector,
+* drained chunks must be reused instead of growing every lap
+*/
+TEST(TWO_LOCK, Circulation)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_TWO_LOCK };
+	vector_t* vector = vector_create_attr(1, &attr);
+
+	void* data_ptr = nullptr;
+	size_t capacity = 0;
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_LE(capacity, 2);
+
+	vector_destroy(vector);
+}
+
+TEST(TWO_LOCK, Shrink_After_Spike)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_TWO_LOCK };
+	attr.shrink_threshold = 0.25;
+	attr.shrink_delay = 16;
+
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	void* data_ptr = nullptr;
+	size_t capacity = 0;
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	ASSERT_EQ(vector_get_capacity(vector, &capacity), VECTOR_SUCCESS);
+	EXPECT_GE(capacity, 4);
+	EXPECT_LT(capacity, 64);
+
+	vector_destroy(vector);
+}
+
+TEST(TWO_LOCK, MPMC_FullVector_Overflow)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 10,
+			.data_amount = 20000,
+			.producers_n = 5,
+			.consumers_n = 5,
+			.producer_sleep = 0,
+			.consumer_sleep = 0,
+			.vector_mode = VECTOR_MODE_TWO_LOCK
+	});
+}
+
+TEST(TWO_LOCK, FIFO_Per_Producer)
+{
+	fifo_per_producer_simulate(VECTOR_MODE_TWO_LOCK, 4, 4);
+}
+
+struct sized_record_t
+{
+	size_t seq;
+	char payload[43];	// odd size, cells are not pointer aligned
+};
+
+TEST(SIZED, Invalid_Use)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKFREE, .element_size = sizeof(sized_record_t) };
+	EXPECT_EQ(vector_create_attr(5, &attr), nullptr);
+
+	vector_t* vector = vector_create_sized(5, sizeof(sized_record_t));
+	void* data_ptr = nullptr;
+	size_t popped = 0;
+
+	// Pointer functions would copy the wrong number of bytes
+	EXPECT_EQ(vector_push(vector, data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop(vector, &data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_push_n(vector, &data_ptr, 1), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_n(vector, &data_ptr, 1, &popped), VECTOR_FAILURE);
+
+	EXPECT_EQ(vector_push_copy(vector, nullptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_pop_copy(vector, nullptr), VECTOR_FAILURE);
+
+	vector_destroy(vector);
+}
+
+class SIZED_MODE : public ::testing::TestWithParam<vector_mode_t> {};
+
+/*
+* Records are copied in and out through growth and circulation
+*/
+TEST_P(SIZED_MODE, Push_Pop_Copy)
+{
+	vector_attr_t attr = { .mode = GetParam(), .element_size = sizeof(sized_record_t) };
+	vector_t* vector = vector_create_attr(3, &attr);
+
+	sized_record_t record = {};
+
+	for (size_t lap = 0; lap < 3; lap++) {
+		for (size_t i = 0; i < 100; i++) {
+			record.seq = i;
+			memset(record.payload, (int)(i & 0x7f), sizeof(record.payload));
+			ASSERT_EQ(vector_push_copy(vector, &record), VECTOR_SUCCESS);
+		}
+
+		for (size_t i = 0; i < 100; i++) {
+			ASSERT_EQ(vector_pop_copy(vector, &record), VECTOR_SUCCESS);
+			ASSERT_EQ(record.seq, i);
+			ASSERT_EQ(record.payload[0], (char)(i & 0x7f));
+			ASSERT_EQ(record.payload[sizeof(record.payload) - 1], (char)(i & 0x7f));
+		}
+	}
+
+	EXPECT_EQ(vector_try_pop_copy(vector, &record), VECTOR_EMPTY);
+
+	vector_destroy(vector);
+}
+
+TEST_P(SIZED_MODE, Batch_Copy)
+{
+	vector_attr_t attr = { .mode = GetParam(), .element_size = sizeof(sized_record_t) };
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	sized_record_t records[10] = {};
+	size_t popped = 0;
+	size_t expected = 0;
+
+	for (size_t batch = 0; batch < 10; batch++) {
+		for (size_t i = 0; i < 10; i++)
+			records[i].seq = batch * 10 + i;
+
+		ASSERT_EQ(vector_push_n_copy(vector, records, 10), VECTOR_SUCCESS);
+	}
+
+	while (expected < 100) {
+		ASSERT_EQ(vector_pop_n_copy(vector, records, 7, &popped), VECTOR_SUCCESS);
+
+		for (size_t i = 0; i < popped; i++)
+			ASSERT_EQ(records[i].seq, expected++);
+	}
+
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, SIZED_MODE, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK, VECTOR_MODE_SPSC));
+
+/*
+* Elements must survive crossing many segment boundaries
+*/
+TEST(SPSC_MODE, ZeroCapacity_Overflow)
+{
+	const size_t num_of_data = 10000;
+
+	vector_attr_t attr = { .mode = VECTOR_MODE_SPSC };
+	vector_t* vector = vector_create_attr(0, &attr);
+	void* data_ptr = nullptr;
+	size_t capacity = 0;
+
+	for (size_t lap = 0; lap < 2; lap++) {
+		for (size_t data_n = 0; data_n < num_of_data; data_n++) {
+			ASSERT_EQ(vector_push(vector, (void*)data_n), VECTOR_SUCCESS);
+		}
+
+		for (size_t data_n = 0; data_n < num_of_data; data_n++) {
+			ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+			ASSERT_EQ((size_t)data_ptr, data_n);
+		}
+	}
+
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
+	EXPECT_EQ(vector_get_capacity(vector, &capacity), VECTOR_FAILURE);
+
+	vector_destroy(vector);
+}
+
+class SPSC_WAIT : public ::testing::TestWithParam<vector_wait_t> {};
+
+TEST_P(SPSC_WAIT, Pop_Block_Push)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 2,
+			.data_amount = 2000,
+			.producers_n = 1,
+			.consumers_n = 1,
+			.producer_sleep = 1,
+			.consumer_sleep = 0,
+			.vector_mode = VECTOR_MODE_SPSC,
+			.vector_wait = GetParam()
+	});
+}
+
+TEST_P(SPSC_WAIT, FullVector_Overflow)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 2,
+			.data_amount = 200000,
+			.producers_n = 1,
+			.consumers_n = 1,
+			.producer_sleep = 0,
+			.consumer_sleep = 0,
+			.vector_mode = VECTOR_MODE_SPSC,
+			.vector_wait = GetParam()
+	});
+}
+
+INSTANTIATE_TEST_SUITE_P(WAIT, SPSC_WAIT, ::testing::Values(VECTOR_WAIT_PARK, VECTOR_WAIT_SPIN,
+															 VECTOR_WAIT_YIELD, VECTOR_WAIT_ADAPTIVE));
+
+TEST(SPSC_MODE, FIFO)
+{
+	fifo_per_producer_simulate(VECTOR_MODE_SPSC, 1, 1);
+}
+
+TEST(SHARDED, NULL_INPUT_TEST)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_SPSC };
+	EXPECT_EQ(sharded_create(4, 16, &attr), nullptr);
+
+	sharded_t* sharded = sharded_create(4, 16, nullptr);
+	void* data_ptr = nullptr;
+	size_t shards = 0;
+
+	EXPECT_EQ(sharded_push(nullptr, data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(sharded_pop(sharded, nullptr), VECTOR_FAILURE);
+	EXPECT_EQ(sharded_try_pop(nullptr, &data_ptr), VECTOR_FAILURE);
+	EXPECT_EQ(sharded_destroy(nullptr), VECTOR_FAILURE);
+
+	ASSERT_EQ(sharded_get_shards(sharded, &shards), VECTOR_SUCCESS);
+	EXPECT_EQ(shards, 4);
+
+	sharded_destroy(sharded);
+}
+
+TEST(SHARDED, Push_Pop)
+{
+	sharded_t* sharded = sharded_create(0, 0, nullptr);
+	void* data_ptr = nullptr;
+
+	// One thread always uses the same shard, so its elements keep their order
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(sharded_push(sharded, (void*)i), VECTOR_SUCCESS);
+	}
+
+	for (size_t i = 0; i < 1000; i++) {
+		ASSERT_EQ(sharded_pop(sharded, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	EXPECT_EQ(sharded_try_pop(sharded, &data_ptr), VECTOR_EMPTY);
+
+	sharded_destroy(sharded);
+}
+
+/*
+* Consumers start first and block, every element is popped once
+* and elements of each producer come out in order
+*/
+TEST(SHARDED, FIFO_Per_Producer)
+{
+	const size_t producers_n = 4;
+	const size_t consumers_n = 4;
+	const size_t per_producer = 20000;
+	const size_t per_consumer = per_producer * producers_n / consumers_n;
+
+	sharded_t* sharded = sharded_create(4, 16, nullptr);
+
+	std::vector<std::thread> producers;
+	std::vector<std::thread> consumers;
+
+	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
+		consumers.push_back(std::thread([=]() {
+			std::vector<size_t> last_seq(producers_n, 0);
+			void* data_ptr = nullptr;
+
+			for (size_t iter = 0; iter < per_consumer; iter++) {
+				ASSERT_EQ(sharded_pop(sharded, &data_ptr), VECTOR_SUCCESS);
+
+				size_t producer = (size_t)data_ptr >> 32;
+				size_t seq = (size_t)data_ptr & 0xFFFFFFFF;
+
+				ASSERT_LT(producer, producers_n);
+				ASSERT_GT(seq, last_seq[producer]);
+				last_seq[producer] = seq;
+			}
+		}));
+	}
+
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		producers.push_back(std::thread([=]() {
+			for (size_t seq = 1; seq <= per_producer; seq++) {
+				EXPECT_EQ(sharded_push(sharded, (void*)((thread_n << 32) | seq)), VECTOR_SUCCESS);
+			}
+		}));
+	}
+
+	std::for_each(producers.begin(), producers.end(), [](std::thread& t1) { t1.join(); });
+	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t2) { t2.join(); });
+
+	void* data_ptr = nullptr;
+	EXPECT_EQ(sharded_try_pop(sharded, &data_ptr), VECTOR_EMPTY);
+
+	sharded_destroy(sharded);
+}
+
+class RESERVE_MODE : public ::testing::TestWithParam<vector_mode_t> {};
+
+TEST(RESERVE, Invalid_Use)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKFREE };
+	vector_t* vector = vector_create_attr(5, &attr);
+	vector_slot_t slot = {};
+
+	EXPECT_EQ(vector_reserve(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_peek_claim(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_try_peek_claim(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_commit(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_release(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_reserve(nullptr, &slot), VECTOR_FAILURE);
+
+	vector_destroy(vector);
+}
+
+TEST_P(RESERVE_MODE, Reserve_Commit_Claim_Release)
+{
+	vector_attr_t attr = { .mode = GetParam(), .element_size = sizeof(sized_record_t) };
+	vector_t* vector = vector_create_attr(3, &attr);
+	vector_slot_t slot = {};
+
+	for (size_t lap = 0; lap < 3; lap++) {
+		for (size_t i = 0; i < 50; i++) {
+			ASSERT_EQ(vector_reserve(vector, &slot), VECTOR_SUCCESS);
+			((sized_record_t*)slot.element)->seq = i;
+			ASSERT_EQ(vector_commit(vector, &slot), VECTOR_SUCCESS);
+		}
+
+		for (size_t i = 0; i < 50; i++) {
+			ASSERT_EQ(vector_peek_claim(vector, &slot), VECTOR_SUCCESS);
+			ASSERT_EQ(((sized_record_t*)slot.element)->seq, i);
+			ASSERT_EQ(vector_release(vector, &slot), VECTOR_SUCCESS);
+		}
+	}
+
+	// A slot is handed back once only
+	EXPECT_EQ(vector_release(vector, &slot), VECTOR_FAILURE);
+	EXPECT_EQ(vector_try_peek_claim(vector, &slot), VECTOR_EMPTY);
+
+	sized_record_t record = {};
+	EXPECT_EQ(vector_try_pop_copy(vector, &record), VECTOR_EMPTY);
+
+	vector_destroy(vector);
+}
+
+/*
+* An uncommitted slot does not hold up the elements pushed after it
+*/
+TEST_P(RESERVE_MODE, Slow_Writer)
+{
+	vector_attr_t attr = { .mode = GetParam() };
+	vector_t* vector = vector_create_attr(2, &attr);
+	vector_slot_t slow = {};
+	void* data_ptr = nullptr;
+
+	ASSERT_EQ(vector_reserve(vector, &slow), VECTOR_SUCCESS);
+
+	for (size_t i = 1; i <= 10; i++)
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+
+	for (size_t i = 1; i <= 10; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ(data_ptr, (void*)i);
+	}
+
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
+
+	*(void**)slow.element = (void*)100;
+	ASSERT_EQ(vector_commit(vector, &slow), VECTOR_SUCCESS);
+
+	ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+	EXPECT_EQ(data_ptr, (void*)100);
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
+
+	vector_destroy(vector);
+}
+
+/*
+* Writers and readers work on the cells outside of the vector locks
+*/
+TEST_P(RESERVE_MODE, MPMC_Zero_Copy)
+{
+	const size_t producers_n = 4;
+	const size_t consumers_n = 4;
+	const size_t per_producer = 20000;
+	const size_t per_consumer = per_producer * producers_n / consumers_n;
+
+	vector_attr_t attr = { .mode = GetParam(), .shrink_threshold = 0.25, .shrink_delay = 16 };
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	std::vector<std::thread> producers;
+	std::vector<std::thread> consumers;
+	std::atomic<size_t> sum(0);
+
+	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
+		consumers.push_back(std::thread([&]() {
+			vector_slot_t slot = {};
+
+			for (size_t iter = 0; iter < per_consumer; iter++) {
+				ASSERT_EQ(vector_peek_claim(vector, &slot), VECTOR_SUCCESS);
+				sum += (size_t)*(void**)slot.element;
+				ASSERT_EQ(vector_release(vector, &slot), VECTOR_SUCCESS);
+			}
+		}));
+	}
+
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		producers.push_back(std::thread([&]() {
+			vector_slot_t slot = {};
+
+			for (size_t seq = 1; seq <= per_producer; seq++) {
+				ASSERT_EQ(vector_reserve(vector, &slot), VECTOR_SUCCESS);
+				*(void**)slot.element = (void*)seq;
+				ASSERT_EQ(vector_commit(vector, &slot), VECTOR_SUCCESS);
+			}
+		}));
+	}
+
+	std::for_each(producers.begin(), producers.end(), [](std::thread& t1) { t1.join(); });
+	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t2) { t2.join(); });
+
+	EXPECT_EQ(sum.load(), producers_n * per_producer * (per_producer + 1) / 2);
+
+	void* data_ptr = nullptr;
+	EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_EMPTY);
+
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, RESERVE_MODE, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK));
+
+#if VECTOR_STATS
+TEST(STATS, Counters)
+{
+	vector_stats_t stats = {};
+	EXPECT_EQ(vector_stats(nullptr, &stats), VECTOR_FAILURE);
+
+	vector_t* vector = vector_create(4);
+	void* data_ptr = nullptr;
+
+	EXPECT_EQ(vector_stats(vector, nullptr), VECTOR_FAILURE);
+
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
+
+	for (size_t i = 0; i < 40; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+	}
+
+	ASSERT_EQ(vector_stats(vector, &stats), VECTOR_SUCCESS);
+	EXPECT_EQ(stats.depth, 60);
+	EXPECT_EQ(stats.high_watermark, 100);
+	EXPECT_GE(stats.capacity, 100);
+	EXPECT_EQ(stats.pushes, 100);
+	EXPECT_EQ(stats.pops, 40);
+	EXPECT_GT(stats.expansions, 0);
+	EXPECT_GE(stats.bytes_allocated, 96 * sizeof(void*));
+	EXPECT_EQ(stats.waits, 0);
+
+	// A consumer sleeps on the EMPTY vector until the push
+	auto consumer = std::thread([=]() {
+		void* data_ptr = nullptr;
+
+		for (size_t i = 0; i < 61; i++) {
+			ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		}
+	});
+
+	usleep(50000);
+	ASSERT_EQ(vector_push(vector, (void*)1), VECTOR_SUCCESS);
+	consumer.join();
+
+	ASSERT_EQ(vector_stats_reset(vector, &stats), VECTOR_SUCCESS);
+	EXPECT_EQ(stats.depth, 0);
+	EXPECT_EQ(stats.pushes, 101);
+	EXPECT_EQ(stats.pops, 101);
+	EXPECT_GE(stats.waits, 1);
+
+	// Counters restart, gauges do not
+	ASSERT_EQ(vector_push(vector, (void*)1), VECTOR_SUCCESS);
+	ASSERT_EQ(vector_stats(vector, &stats), VECTOR_SUCCESS);
+	EXPECT_EQ(stats.depth, 1);
+	EXPECT_EQ(stats.high_watermark, 100);
+	EXPECT_EQ(stats.pushes, 1);
+	EXPECT_EQ(stats.pops, 0);
+	EXPECT_EQ(stats.expansions, 0);
+	EXPECT_EQ(stats.waits, 0);
+
+	vector_destroy(vector);
+}
+
+TEST(STATS, Lockless_Depth)
+{
+	for (vector_mode_t mode : { VECTOR_MODE_LOCKFREE, VECTOR_MODE_SPSC }) {
+		vector_attr_t attr = { .mode = mode };
+		vector_t* vector = vector_create_attr(4, &attr);
+
+		vector_stats_t stats = {};
+		void* data_ptr = nullptr;
+
+		for (size_t i = 0; i < 10; i++) {
+			ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+		}
+
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_stats_reset(vector, &stats), VECTOR_SUCCESS);
+		EXPECT_EQ(stats.depth, 9);
+		EXPECT_EQ(stats.pushes, 10);
+		EXPECT_EQ(stats.pops, 1);
+
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ(vector_stats(vector, &stats), VECTOR_SUCCESS);
+		EXPECT_EQ(stats.depth, 8);
+		EXPECT_EQ(stats.pushes, 0);
+		EXPECT_EQ(stats.pops, 1);
+
+		vector_destroy(vector);
+	}
+}
+
+/*
+* Readers and resets racing each other never see a counter above what was done
+*/
+TEST(STATS, Concurrent_Reset)
+{
+	const size_t producers_n = 4;
+	const size_t per_producer = 50000;
+
+	vector_t* vector = vector_create(16);
+	std::atomic<bool> done{ false };
+	std::vector<std::thread> threads;
+
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		threads.push_back(std::thread([=]() {
+			for (size_t i = 0; i < per_producer; i++) {
+				ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+			}
+		}));
+	}
+
+	for (bool reset : { false, true, false, true }) {
+		threads.push_back(std::thread([=, &done]() {
+			vector_stats_t stats = {};
+
+			while (!done.load()) {
+				ASSERT_EQ(reset ? vector_stats_reset(vector, &stats) : vector_stats(vector, &stats), VECTOR_SUCCESS);
+				ASSERT_LE(stats.pushes, producers_n * per_producer);
+				ASSERT_EQ(stats.pops, 0);
+			}
+		}));
+	}
+
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		threads[thread_n].join();
+	}
+
+	done = true;
+	std::for_each(threads.begin() + producers_n, threads.end(), [](std::thread& t) { t.join(); });
+
+	vector_destroy(vector);
+}
+#endif
+
+class LATENCY_MODE : public ::testing::TestWithParam<vector_mode_t> {};
+
+TEST(LATENCY, Invalid_Use)
+{
+	vector_attr_t attr = { .mode = VECTOR_MODE_LOCKFREE, .latency = true };
+	EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+
+	vector_t* vector = vector_create(4);
+	vector_latency_t latency = {};
+
+	EXPECT_EQ(vector_get_latency(vector, &latency), VECTOR_FAILURE);
+	EXPECT_EQ(vector_get_latency(nullptr, &latency), VECTOR_FAILURE);
+
+	vector_destroy(vector);
+}
+
+TEST_P(LATENCY_MODE, Percentiles)
+{
+	vector_attr_t attr = { .mode = GetParam(), .latency = true };
+	vector_t* vector = vector_create_attr(4, &attr);
+
+	vector_latency_t latency = {};
+	void* data_ptr = nullptr;
+
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+	}
+
+	usleep(10000);
+
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		ASSERT_EQ((size_t)data_ptr, i);
+	}
+
+	ASSERT_EQ(vector_get_latency(vector, &latency), VECTOR_SUCCESS);
+	EXPECT_EQ(latency.count, 100);
+	EXPECT_GE(latency.p50_ns, 10000000);
+	EXPECT_LE(latency.p50_ns, latency.p99_ns);
+	EXPECT_LE(latency.p99_ns, latency.p999_ns);
+	EXPECT_LE(latency.p999_ns, latency.max_ns);
+
+	vector_destroy(vector);
+}
+
+/*
+* Stamps travel with sized records through batches and zero-copy slots
+*/
+TEST_P(LATENCY_MODE, Sized_Batch_Slots)
+{
+	vector_attr_t attr = { .mode = GetParam(), .element_size = sizeof(sized_record_t), .latency = true };
+	vector_t* vector = vector_create_attr(3, &attr);
+
+	sized_record_t records[10] = {};
+	vector_slot_t slot = {};
+	vector_latency_t latency = {};
+	size_t popped = 0;
+	size_t expected = 0;
+
+	for (size_t batch = 0; batch < 10; batch++) {
+		for (size_t i = 0; i < 10; i++) {
+			records[i].seq = batch * 10 + i;
+			memset(records[i].payload, (int)i, sizeof(records[i].payload));
+		}
+
+		ASSERT_EQ(vector_push_n_copy(vector, records, 10), VECTOR_SUCCESS);
+	}
+
+	ASSERT_EQ(vector_reserve(vector, &slot), VECTOR_SUCCESS);
+	((sized_record_t*)slot.element)->seq = 100;
+	ASSERT_EQ(vector_commit(vector, &slot), VECTOR_SUCCESS);
+
+	// The reserved record is left for vector_peek_claim()
+	while (expected < 100) {
+		ASSERT_EQ(vector_pop_n_copy(vector, records, std::min<size_t>(7, 100 - expected), &popped), VECTOR_SUCCESS);
+
+		for (size_t i = 0; i < popped; i++) {
+			ASSERT_EQ(records[i].seq, expected);
+			ASSERT_EQ(records[i].payload[sizeof(records[i].payload) - 1], (char)(expected % 10));
+			expected++;
+		}
+	}
+
+	ASSERT_EQ(vector_peek_claim(vector, &slot), VECTOR_SUCCESS);
+	EXPECT_EQ(((sized_record_t*)slot.element)->seq, 100);
+	ASSERT_EQ(vector_release(vector, &slot), VECTOR_SUCCESS);
+
+	ASSERT_EQ(vector_get_latency(vector, &latency), VECTOR_SUCCESS);
+	EXPECT_EQ(latency.count, 101);
+
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, LATENCY_MODE, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK));
+
+class LOCK_BACKEND : public ::testing::TestWithParam<std::tuple<vector_mode_t, vector_lock_t>> {};
+
+TEST(LOCK, Invalid_Use)
+{
+	vector_attr_t attr = { .lock = (vector_lock_t)(VECTOR_LOCK_MCS + 1) };
+	EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+
+	for (vector_mode_t mode : { VECTOR_MODE_LOCKFREE, VECTOR_MODE_SPSC }) {
+		attr = { .mode = mode, .lock = VECTOR_LOCK_TTAS };
+		EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+	}
+}
+
+/*
+* Every lock in both chunk ring modes, with the vector growing and consumers waiting
+*/
+TEST_P(LOCK_BACKEND, MPMC_FullVector_Overflow)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 4,
+			.data_amount = 20000,
+			.producers_n = 4,
+			.consumers_n = 4,
+			.producer_sleep = 0,
+			.consumer_sleep = 0,
+			.vector_mode = std::get<0>(GetParam()),
+			.vector_wait = VECTOR_WAIT_PARK,
+			.vector_lock = std::get<1>(GetParam())
+	});
+}
+
+TEST_P(LOCK_BACKEND, Reserve_While_Popping)
+{
+	vector_attr_t attr = { .mode = std::get<0>(GetParam()), .lock = std::get<1>(GetParam()) };
+	vector_t* vector = vector_create_attr(2, &attr);
+	const size_t items = 4000;
+
+	// Slots are reserved under a side's lock and then 'slot_guard', two locks held at once
+	std::thread producer([=]() {
+		vector_slot_t slot;
+
+		for (size_t i = 0; i < items; i++) {
+			ASSERT_EQ(vector_reserve(vector, &slot), VECTOR_SUCCESS);
+			*(size_t*)slot.element = i;
+			ASSERT_EQ(vector_commit(vector, &slot), VECTOR_SUCCESS);
+		}
+	});
+
+	void* data_ptr = nullptr;
+
+	for (size_t i = 0; i < items; i++) {
+		ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+		EXPECT_EQ((size_t)data_ptr, i);
+	}
+
+	producer.join();
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(LOCK, LOCK_BACKEND, ::testing::Combine(
+	::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK),
+	::testing::Values(VECTOR_LOCK_MUTEX, VECTOR_LOCK_ADAPTIVE, VECTOR_LOCK_TTAS, VECTOR_LOCK_TICKET, VECTOR_LOCK_MCS)));
+
+class ELIMINATION_MODE : public ::testing::TestWithParam<vector_mode_t> {};
+
+TEST(ELIMINATION, Invalid_Use)
+{
+	for (vector_mode_t mode : { VECTOR_MODE_LOCKFREE, VECTOR_MODE_SPSC }) {
+		vector_attr_t attr = { .mode = mode, .elimination = true };
+		EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+	}
+
+	vector_attr_t attr = { .latency = true, .elimination = true };
+	EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+}
+
+TEST_P(ELIMINATION_MODE, MPMC_Pop_Block_Push)
+{
+	mpmc_simulate(mpmc_sim_opt_t {
+		.vector_size = 4,
+			.data_amount = 20000,
+			.producers_n = 4,
+			.consumers_n = 4,
+			.producer_sleep = 0,
+			.consumer_sleep = 0,
+			.vector_mode = GetParam(),
+			.vector_wait = VECTOR_WAIT_YIELD,
+			.vector_lock = VECTOR_LOCK_MUTEX,
+			.elimination = true
+	});
+}
+
+/*
+* An element may skip the ring only when the ring is EMPTY, so no producer's order changes
+*/
+TEST_P(ELIMINATION_MODE, FIFO_Per_Producer)
+{
+	fifo_per_producer_simulate(GetParam(), 4, 4, true);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, ELIMINATION_MODE, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK));
+
+class READINESS_FD : public ::testing::TestWithParam<vector_mode_t> {};
+
+static bool fd_readable(int fd, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+	return poll(&pfd, 1, timeout_ms) == 1 && (pfd.revents & POLLIN);
+}
+
+TEST(READINESS, Invalid_Use)
+{
+	for (vector_mode_t mode : { VECTOR_MODE_LOCKFREE, VECTOR_MODE_SPSC }) {
+		vector_attr_t attr = { .mode = mode, .readiness_fd = true };
+		EXPECT_EQ(vector_create_attr(4, &attr), nullptr);
+	}
+
+	vector_t* vector = vector_create(4);
+	int fd = -1;
+
+	EXPECT_EQ(vector_get_fd(vector, &fd), VECTOR_FAILURE);
+	EXPECT_EQ(vector_get_fd(vector, nullptr), VECTOR_FAILURE);
+	EXPECT_EQ(vector_get_fd(nullptr, &fd), VECTOR_FAILURE);
+
+	vector_destroy(vector);
+}
+
+TEST_P(READINESS_FD, Edge_Coalesced)
+{
+	vector_attr_t attr = { .mode = GetParam(), .readiness_fd = true };
+	vector_t* vector = vector_create_attr(4, &attr);
+	void* data_ptr = nullptr;
+	int fd = -1;
+
+	ASSERT_EQ(vector_get_fd(vector, &fd), VECTOR_SUCCESS);
+	EXPECT_FALSE(fd_readable(fd, 0));
+
+	for (size_t i = 0; i < 100; i++)
+		EXPECT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+
+	EXPECT_TRUE(fd_readable(fd, 0));
+
+	// Draining half of it leaves the fd readable
+	for (size_t i = 0; i < 50; i++)
+		EXPECT_EQ(vector_try_pop(vector, &data_ptr), VECTOR_SUCCESS);
+
+	EXPECT_TRUE(fd_readable(fd, 0));
+
+	while (vector_try_pop(vector, &data_ptr) == VECTOR_SUCCESS)
+		;
+
+	EXPECT_FALSE(fd_readable(fd, 0));
+
+	// The next burst signals again
+	EXPECT_EQ(vector_push(vector, nullptr), VECTOR_SUCCESS);
+	EXPECT_TRUE(fd_readable(fd, 0));
+
+	vector_destroy(vector);
+}
+
+/*
+* An event loop thread that sleeps in epoll_wait() only, never in vector_pop()
+*/
+TEST_P(READINESS_FD, Epoll_Consumer)
+{
+	vector_attr_t attr = { .mode = GetParam(), .readiness_fd = true };
+	vector_t* vector = vector_create_attr(4, &attr);
+	const size_t producers_n = 4;
+	const size_t per_producer = 5000;
+	int fd = -1;
+
+	ASSERT_EQ(vector_get_fd(vector, &fd), VECTOR_SUCCESS);
+
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event = { .events = EPOLLIN | EPOLLET, .data = { .fd = fd } };
+	ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event), 0);
+
+	std::vector<std::thread> producers;
+
+	for (size_t producer_n = 0; producer_n < producers_n; producer_n++) {
+		producers.emplace_back([=]() {
+			for (size_t i = 1; i <= per_producer; i++) {
+				EXPECT_EQ(vector_push(vector, (void*)i), VECTOR_SUCCESS);
+
+				if (i % 500 == 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	size_t popped = 0;
+	size_t sum = 0;
+
+	while (popped < producers_n * per_producer) {
+		ASSERT_EQ(epoll_wait(epfd, &event, 1, 5000), 1) << "no readiness after " << popped << " elements";
+
+		void* data_ptr = nullptr;
+
+		while (vector_try_pop(vector, &data_ptr) == VECTOR_SUCCESS) {
+			sum += (size_t)data_ptr;
+			popped++;
+		}
+	}
+
+	for (auto& producer : producers)
+		producer.join();
+
+	EXPECT_EQ(sum, producers_n * per_producer * (per_producer + 1) / 2);
+
+	close(epfd);
+	vector_destroy(vector);
+}
+
+INSTANTIATE_TEST_SUITE_P(MODE, READINESS_FD, ::testing::Values(VECTOR_MODE_LOCKED, VECTOR_MODE_TWO_LOCK));
+
+// Counts live instances, to see that the queue destroys what it holds
+struct tracked_t
+{
+	static std::atomic<int> live;
+	std::string payload;
+
+	explicit tracked_t(std::string text) : payload(std::move(text)) { live++; }
+	tracked_t(tracked_t&& other) noexcept : payload(std::move(other.payload)) { live++; }
+	tracked_t& operator=(tracked_t&& other) noexcept { payload = std::move(other.payload); return *this; }
+	~tracked_t() { live--; }
+};
+
+std::atomic<int> tracked_t::live{ 0 };
+
+static_assert(mpmc::queue<int>::mode == VECTOR_MODE_LOCKED);
+static_assert(mpmc::queue<int, 1, 1>::mode == VECTOR_MODE_SPSC);
+static_assert(mpmc::queue<std::string, 1, 1>::mode == VECTOR_MODE_TWO_LOCK);
+static_assert(mpmc::queue<int, 4, 1>::mode == VECTOR_MODE_TWO_LOCK);
+
+TEST(CPP_QUEUE, Move_Only)
+{
+	mpmc::queue<std::unique_ptr<int>> queue(2);
+
+	for (int i = 0; i < 10; i++)
+		queue.push(std::make_unique<int>(i));
+
+	for (int i = 0; i < 10; i++)
+		EXPECT_EQ(*queue.pop(), i);
+
+	std::unique_ptr<int> out;
+	EXPECT_FALSE(queue.try_pop(out));
+}
+
+TEST(CPP_QUEUE, Emplace_And_Leftovers)
+{
+	{
+		mpmc::queue<tracked_t> queue(1);
+
+		for (int i = 0; i < 100; i++)
+			queue.emplace(std::string(64, 'a' + i % 26));	// long enough to live on the heap
+
+		EXPECT_EQ(tracked_t::live, 100);
+		EXPECT_EQ(queue.pop().payload, std::string(64, 'a'));
+		EXPECT_EQ(tracked_t::live, 99);
+	}
+
+	EXPECT_EQ(tracked_t::live, 0);
+}
+
+TEST(CPP_QUEUE, Trivial_Batches)
+{
+	struct point_t { double x, y, z; };
+	mpmc::queue<point_t> queue(4);
+
+	point_t in[64], out[64];
+	for (int i = 0; i < 64; i++)
+		in[i] = { (double)i, (double)-i, 0.5 };
+
+	queue.push_n(in, 64);
+	EXPECT_EQ(queue.pop_n(out, 64), 64u);
+
+	for (int i = 0; i < 64; i++)
+		EXPECT_EQ(out[i].x, i);
+}
+
+TEST(CPP_QUEUE, One_To_One_Strings)
+{
+	mpmc::queue<std::string, 1, 1> queue;
+	const int items = 10000;
+
+	std::thread producer([&]() {
+		for (int i = 0; i < items; i++)
+			queue.push(std::to_string(i));
+	});
+
+	for (int i = 0; i < items; i++)
+		ASSERT_EQ(queue.pop(), std::to_string(i));
+
+	producer.join();
+}
+
+TEST(CPP_QUEUE, MPMC_Sum)
+{
+	mpmc::queue<uint64_t> queue(16);
+	const uint64_t per_producer = 20000;
+	std::atomic<uint64_t> sum{ 0 };
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 1; i <= per_producer; i++)
+				queue.push(i);
+		});
+		threads.emplace_back([&]() {
+			uint64_t local = 0;
+			uint64_t batch[32];
+
+			for (uint64_t taken = 0; taken < per_producer;) {
+				size_t n = queue.pop_n(batch, std::min<uint64_t>(32, per_producer - taken));
+
+				for (size_t i = 0; i < n; i++)
+					local += batch[i];
+				taken += n;
+			}
+			sum += local;
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(sum, 4 * per_producer * (per_producer + 1) / 2);
+}
+
+template <typename Queue>
+detached coro_take(Queue* queue, size_t count, std::vector<typename Queue::value_type>* out)
+{
+	for (size_t i = 0; i < count; i++)
+		out->push_back(co_await queue->pop());
+}
+
+// Sums until it pops a 0, on a thread of `scheduler`
+template <typename Scheduler>
+detached coro_sum(Scheduler* scheduler, mpmc::async_queue<uint64_t, Scheduler>* queue,
+				  std::atomic<uint64_t>* sum, std::atomic<size_t>* running)
+{
+	co_await scheduler->enter();
+
+	uint64_t local = 0;
+	for (;;) {
+		uint64_t value = co_await queue->pop();
+
+		if (value == 0)
+			break;
+		local += value;
+	}
+
+	*sum += local;
+	(*running)--;
+}
+
+template <typename Scheduler>
+uint64_t coro_simulate(Scheduler& scheduler, size_t producers, size_t consumers, uint64_t per_producer)
+{
+	mpmc::async_queue<uint64_t, Scheduler> queue(scheduler, 16);
+	std::atomic<uint64_t> sum{ 0 };
+	std::atomic<size_t> running{ consumers };
+	std::vector<std::thread> threads;
+
+	for (size_t c = 0; c < consumers; c++)
+		coro_sum(&scheduler, &queue, &sum, &running);
+
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&]() {
+			for (uint64_t i = 1; i <= per_producer; i++)
+				queue.push(i);
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (size_t c = 0; c < consumers; c++)
+		queue.push(0);
+
+	while (running > 0)
+		std::this_thread::yield();
+
+	return sum;
+}
+
+TEST(CORO, Ready_Without_Suspending)
+{
+	mpmc::inline_scheduler scheduler;
+	mpmc::async_queue<int> queue(scheduler);
+	std::vector<int> out;
+
+	queue.push(1);
+	queue.push(2);
+	coro_take(&queue, 2, &out);
+
+	EXPECT_EQ(out, std::vector<int>({ 1, 2 }));
+}
+
+/*
+* Suspended pops are served oldest first, each push resumes one of them with its own element
+*/
+TEST(CORO, Push_Resumes_Awaiter)
+{
+	mpmc::inline_scheduler scheduler;
+	mpmc::async_queue<std::unique_ptr<int>> queue(scheduler);
+	std::vector<std::unique_ptr<int>> out[3];
+
+	for (size_t i = 0; i < 3; i++)
+		coro_take(&queue, 1, &out[i]);
+
+	for (size_t i = 0; i < 3; i++) {
+		EXPECT_TRUE(out[i].empty());
+		queue.push(std::make_unique<int>(i));
+
+		ASSERT_EQ(out[i].size(), 1u);
+		EXPECT_EQ(*out[i][0], (int)i);
+	}
+
+	EXPECT_FALSE(queue.try_pop().has_value());
+}
+
+TEST(CORO, Run_Loop)
+{
+	run_loop loop;
+	std::thread loop_thread([&]() { loop.run(); });
+
+	EXPECT_EQ(coro_simulate(loop, 4, 8, 10000), 4 * 10000ull * 10001 / 2);
+
+	loop.stop();
+	loop_thread.join();
+}
+
+TEST(CORO, Thread_Pool)
+{
+	thread_pool pool(3);
+
+	EXPECT_EQ(coro_simulate(pool, 4, 8, 10000), 4 * 10000ull * 10001 / 2);
+}
+
+// Recursive function to return gcd of a and b
+long long gcd(long long int a, long long int b)
+{
+	if (b == 0)
+		return a;
+	return gcd(b, a % b);
+}
+
+// Function to return LCM of two numbers
+long long lcm(int a, int b)
+{
+	return (a / gcd(a, b)) * b;
+}
+
+int my_accumulate(int* result, size_t n) {
+	return std::accumulate(result, result + n, 0);
+}
+
+void mpmc_simulate(mpmc_sim_opt_t options)
+{
+	size_t vector_size = options.vector_size;
+	size_t data_amount = options.data_amount;
+	size_t producers_n = options.producers_n; 
+	size_t consumers_n = options.consumers_n;
+	size_t producer_sleep = options.producer_sleep;
+	size_t consumer_sleep = options.consumer_sleep;
+
+	// we need to be sure that data_amount is divisible by both producers_n and consumers_n
+	long long alignment = lcm(producers_n, consumers_n);
+	if (data_amount % alignment != 0) {
+		data_amount += (alignment - data_amount % alignment);
+	}
+
+	vector_attr_t attr = { .mode = options.vector_mode, .wait = options.vector_wait, .lock = options.vector_lock,
+						  .elimination = options.elimination };
+	vector_t* vector = vector_create_attr(vector_size, &attr);
+
+	// consumers_result[i] -- the data popped by consumer 'i'
+	int* consumers_result = new int[consumers_n];
+	memset(consumers_result, 0, consumers_n * sizeof(int));
+
+	// producers_result[i] -- the data pushed by producer 'i'
+	int* producers_result = new int[producers_n];
+	memset(producers_result, 0, producers_n * sizeof(int));
+
+	// Vector contains thread IDs
+	std::vector<std::thread> producers;
+	std::vector<std::thread> consumers;
+
+	// create producers_n amount of producer threads
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		producers.push_back(std::thread([=, &producers_result]() {
+
+			sleep(producer_sleep);
+
+		for (size_t iter = 0; iter < (unsigned int)((double)data_amount / (double)producers_n); iter++) {
+			EXPECT_EQ(vector_push(vector, (void*)(thread_n * iter)), VECTOR_SUCCESS);
+			producers_result[thread_n] += (int)(thread_n * iter);
+		}
+
+			})
+		);
+	}
+
+	// create consumers_n amount of consumer threads
+	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
+		consumers.push_back(std::thread([=, &consumers_result]() {
+
+			void* data_ptr = nullptr;
+
+		sleep(consumer_sleep);
+
+		for (size_t iter = 0; iter < (unsigned int)((double)data_amount / (double)consumers_n); iter++) {
+			EXPECT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+			consumers_result[thread_n] += (intptr_t) data_ptr;
+		}
+
+			})
+		);
+	}
+
+	// Join producers
+	std::for_each(producers.begin(), producers.end(), [](std::thread& t1) { t1.join(); });
+
+	// Join consumers
+	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t2) { t2.join(); });
+
+	vector_destroy(vector);
+
+	// Compare the sum of pushed and popped data
+	EXPECT_EQ(my_accumulate(producers_result, producers_n), my_accumulate(consumers_result, consumers_n));
+
+	delete[] producers_result;
+	delete[] consumers_result;
+}
+
+/*
+* Every producer pushes an increasing sequence tagged with its id.
+* Each consumer must see the sequence of every producer in increasing order.
+*/
+void fifo_per_producer_simulate(vector_mode_t mode, size_t producers_n, size_t consumers_n, bool elimination)
+{
+	const size_t per_producer = 20000;
+	const size_t per_consumer = per_producer * producers_n / consumers_n;
+
+	vector_attr_t attr = { .mode = mode, .elimination = elimination };
+	vector_t* vector = vector_create_attr(16, &attr);
+
+	std::vector<std::thread> producers;
+	std::vector<std::thread> consumers;
+
+	for (size_t thread_n = 0; thread_n < producers_n; thread_n++) {
+		producers.push_back(std::thread([=]() {
+			for (size_t seq = 1; seq <= per_producer; seq++) {
+				EXPECT_EQ(vector_push(vector, (void*)((thread_n << 32) | seq)), VECTOR_SUCCESS);
+			}
+		}));
+	}
+
+	for (size_t thread_n = 0; thread_n < consumers_n; thread_n++) {
+		consumers.push_back(std::thread([=]() {
+			std::vector<size_t> last_seq(producers_n, 0);
+			void* data_ptr = nullptr;
+
+			for (size_t iter = 0; iter < per_consumer; iter++) {
+				ASSERT_EQ(vector_pop(vector, &data_ptr), VECTOR_SUCCESS);
+
+				size_t producer = (size_t)data_ptr >> 32;
+				size_t seq = (size_t)data_ptr & 0xFFFFFFFF;
+
+				ASSERT_LT(producer, producers_n);
+				ASSERT_GT(seq, last_seq[producer]);
+				last_seq[producer] = seq;
+			}
+		}));
+	}
+
+	std::for_each(producers.begin(), producers.end(), [](std::thread& t1) { t1.join(); });
+	std::for_each(consumers.begin(), consumers.end(), [](std::thread& t2) { t2.join(); });
+
+	vector_destroy(vector);
+}
@@ -2,31 +2,109 @@
 * Thread-Safe Unbounded Vector.
 * 
 * Vector's working principles:
-* Vector of size 3
-*   |1|2|3|.|
-*    |     |
-* [begin  end)
+* Vector is a ring of chunks, each chunk is a plain array of cells
+*
+*        begin_chunk             end_chunk
+*   +-> |x|x|1|2| -> |3|4|5|6| -> |7|8|.|.| --+
+*   |        |                         |     |
+*   |      begin                      end    |
+*   +----------------------------------------+
 * 
 * Begin index is inclusive, the element at that index exists
 * End index is exclusive, the element at that index does not exist
+*
+* Producer fills 'end_chunk' from left to right, then moves to the next chunk.
+* Consumer drains 'begin_chunk' from left to right, then moves to the next chunk.
+* Drained chunks stay in the ring and are filled again on the next lap.
 * 
 * Corner cases:
-*	'begin == end' -- vector is empty, because 'end' is exclusive
-*	'next(end) == begin' -- vector is full, because 'end' catched up 'begin'
+*	'begin_chunk == end_chunk && begin == end' -- vector is empty
+*	'end == end_chunk->size && end_chunk->next == begin_chunk' -- vector is full,
+*		because the next chunk still holds unread elements
 * 
-* Vector growth by factor of 2 every time it overflows.
+* Cells hold 'element_size' bytes each, a pointer unless the vector was created sized.
+* Elements are copied in and out, so small records need no allocation of their own.
+* In latency mode a cell also holds the element's push time, and pops record
+* how long the element waited into a histogram (see histogram.c).
+* 
+* Vector growth by factor of 2 every time it overflows:
+* a new chunk as large as the whole vector is linked right after 'end_chunk'.
+* Elements never move, so growth costs the same no matter how deep the vector is.
+* The chunk is allocated with the mutex unlocked, only linking it is done under it.
+*
+* Growth factor and step are configurable. When occupancy stays low for a while,
+* free chunks after 'end_chunk' are unlinked and freed with the mutex unlocked.
+*
+* Chunks come from malloc(), or from address space reserved up front (see arena.c),
+* so deep vectors grow by committing pages, optionally transparent huge pages.
+* With a pool (see pool.c) freed chunks are kept and reused on the next growth,
+* so a vector oscillating between sizes it had before does not allocate.
 * 
 * Vector mutex is locked before modifying vector data
 * e.g. when pushing, popping, and expanding capacity		
+*
+* In VECTOR_MODE_TWO_LOCK producers lock only the tail ('end_chunk', 'end')
+* and consumers only the head ('begin_chunk', 'begin'), each side on its own cache line.
+* Consumers learn how many elements they may read from the 'pushed' counter,
+* producers reuse a chunk only when it is not 'begin_chunk'.
+* Shrinking is the only operation that takes both locks.
+*
+* Consumers of an EMPTY vector sleep on the 'avail' event (see event.c)
+* outside of the mutex. Producers make no syscall unless somebody sleeps.
+* Depending on the wait strategy consumers spin first, watching the
+* 'pushed' and 'popped' counters without taking the mutex.
+*
+* In VECTOR_MODE_LOCKFREE the data lives in a lock-free queue (see lfqueue.c)
+* and in VECTOR_MODE_SPSC in a single-producer single-consumer queue (see spscqueue.c)
+* and the mutex is not used at all.
 */
+#define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 
 #include "vector.h"
+#include "lfqueue.h"
+#include "spscqueue.h"
+#include "arena.h"
+#include "pool.h"
+#include "histogram.h"
+#include "lock.h"
+#include "event.h"
+#include "cpu.h"
 #include "debug.h"
 
+// Smallest segment of a lock-free vector, smaller ones link segments too often
+#define LOCKFREE_MIN_SEGMENT_SIZE 32
+
+// VECTOR_WAIT_YIELD spins that many times before it starts to yield
+#define YIELD_SPIN_LIMIT 128
+
+// Bounds of the learned spin budget of VECTOR_WAIT_ADAPTIVE
+#define ADAPTIVE_SPIN_MIN 16
+#define ADAPTIVE_SPIN_MAX 16384
+
+// Spinning consumers look at the clock once per that many spins
+#define DEADLINE_CHECK_SPINS 64
+
+#define DEFAULT_GROWTH_FACTOR 2.0
+#define DEFAULT_SHRINK_DELAY 1024
+
+// Threads are spread over that many groups of statistics counters
+#define STATS_SHARDS 16
+
+// Exchange slots of the elimination layer, and how long a producer waits in one for a consumer
+#define ELIMINATION_SLOTS 8
+#define ELIMINATION_SPINS 256
+
 #define CHECK_AND_RETURN_IF_NOT_EXIST(pointer_object)  \
     do{                                                \
         if (pointer_object == NULL)                    \
@@ -36,35 +114,286 @@
         }                                              \
     }while(0)
 
+#if VECTOR_STATS
+#define VECTOR_STAT_ADD(vector, stat, n) vector_stat_add(vector, stat, n)
+#else
+#define VECTOR_STAT_ADD(vector, stat, n) ((void)0)
+#endif
+
+typedef struct vector_chunk_t vector_chunk_t;
+
+typedef enum vector_stat_t
+{
+	VECTOR_STAT_PUSHES,
+	VECTOR_STAT_POPS,
+	VECTOR_STAT_EXPANSIONS,
+	VECTOR_STAT_BYTES_ALLOCATED,
+	VECTOR_STAT_CONTENDED,
+	VECTOR_STAT_WAITS,
+	VECTOR_STAT_ELIMINATED,
+	VECTOR_STAT_COUNT
+} vector_stat_t;
+
+/*
+* Exchange slot of the elimination layer, see vector_attr_t 'elimination'.
+*
+*   EMPTY --producer--> OFFERING --producer--> OFFERED --consumer--> CLAIMED --consumer--> DONE
+*                                                 |                     |                   |
+*   EMPTY <--------producer gives up--------------'    back to OFFERED <'   EMPTY <-producer'
+*                                                      if the ring is not empty
+*
+* The producer waits in the slot until DONE, so the consumer copies straight from its buffer.
+*/
+typedef enum vector_exchange_state_t
+{
+	EXCHANGE_EMPTY,
+	EXCHANGE_OFFERING,
+	EXCHANGE_OFFERED,
+	EXCHANGE_CLAIMED,
+	EXCHANGE_DONE
+} vector_exchange_state_t;
+
+typedef struct vector_exchange_t
+{
+	_Alignas(CACHE_LINE_SIZE) atomic_uint state;
+	const void* element;		// written before OFFERED, read after CLAIMED
+} vector_exchange_t;
+
+// Counters of the threads that map to it, on a cache line of its own
+typedef struct vector_stats_shard_t
+{
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t counter[VECTOR_STAT_COUNT];
+} vector_stats_shard_t;
+
+struct vector_chunk_t
+{
+	vector_chunk_t* next;	// chunks form a ring
+	size_t size;
+	size_t alloc_bytes;		// of the whole block, a pooled one may have more than 'size' cells need
+	atomic_size_t pins;		// reserved or claimed cells, producers do not reuse a pinned chunk
+
+	_Alignas(max_align_t) unsigned char cell[];	// 'size' cells of 'cell_size' bytes
+};
+
+typedef struct vector_slot_node_t vector_slot_node_t;
+
+// A reserved cell that is not committed yet, see vector_reserve()
+struct vector_slot_node_t
+{
+	vector_chunk_t* chunk;
+	size_t index;
+
+	vector_slot_node_t* next;
+};
+
+// Cell found by a consumer, from the ring or from the 'ready' list
+typedef struct vector_take_t
+{
+	vector_chunk_t* chunk;
+	unsigned char* cell;
+	bool pinned;			// came from the 'ready' list, its reservation still pins the chunk
+} vector_take_t;
+
 struct vector_t
 {
-	size_t capacity;
-	size_t begin;		// begin index is inclusive
-	size_t end;			// end index is exclusive
+	vector_mode_t mode;
+	size_t element_size;		// bytes copied in and out per element
+	size_t cell_size;			// stride of the cells, the element and in latency mode its push time
+	histogram_t* latency;		// push-to-pop times in nanoseconds, NULL unless latency mode
+
+	atomic_size_t capacity;		// sum of all chunk sizes, written with the producer lock
 
-	void** element;
+	// Capacity policy
+	double growth_factor;
+	size_t max_growth_step;
+	double shrink_threshold;
+	size_t shrink_delay;
+	size_t min_capacity;		// never shrink below it
+	vector_chunk_t* first_chunk;	// created with the vector, never unlinked
+	arena_t* arena;				// chunks are carved from it first, NULL means malloc() only
+	pool_t* pool;				// freed chunks wait here for reuse, NULL means no pool
+	bool own_pool;				// private pool, destroyed with the vector
+	atomic_size_t allocations;	// chunks that did not come from the pool
 
-	pthread_mutex_t vector_guard;
-	pthread_cond_t avail;
+	vector_wait_t wait;
+
+	/*
+	* Consumer side. In VECTOR_MODE_TWO_LOCK it has its own lock and cache line,
+	* in VECTOR_MODE_LOCKED both locks are 'vector_guard'.
+	*/
+	_Alignas(CACHE_LINE_SIZE) lock_t vector_guard;
+	lock_t* head_guard;
+
+	vector_chunk_t* _Atomic begin_chunk;	// read by producers looking for a free chunk
+	size_t begin;				// begin index is inclusive
+
+	atomic_size_t popped;
+	size_t low_streak;			// pops in a row that saw low occupancy
+	atomic_uint spin_budget;	// VECTOR_WAIT_ADAPTIVE only
+
+	// Producer side
+	_Alignas(CACHE_LINE_SIZE) lock_t tail_lock;
+	lock_t* tail_guard;
+
+	vector_chunk_t* end_chunk;
+	size_t end;					// end index is exclusive
+
+	atomic_size_t pushed;		// published after the element, consumers trust it
+	size_t high_watermark;		// largest 'pushed - popped' seen
+	vector_chunk_t* spare;		// allocated by a producer that lost the race to grow
+
+	/*
+	* Reserved cells, see vector_reserve().
+	* Lock order: a side's lock, then 'slot_guard'.
+	*/
+	_Alignas(CACHE_LINE_SIZE) lock_t slot_guard;
+	atomic_size_t pending_n;
+	atomic_size_t ready_n;
+	vector_slot_node_t* pending;	// not committed, consumers did not reach them yet
+	vector_slot_node_t* skipped;	// not committed, consumers passed them
+	vector_slot_node_t* ready;		// committed after consumers passed them, oldest first
+	vector_slot_node_t* ready_tail;
+	vector_slot_node_t* free_nodes;
+
+	_Alignas(CACHE_LINE_SIZE) event_t avail;	// consumers sleep here while vector is EMPTY
+
+	/*
+	* Elimination layer: a push that finds the lock taken and the vector EMPTY
+	* hands its element to a pop right away. Pairing only when the ring is empty keeps FIFO order.
+	*/
+	bool elimination;
+	vector_exchange_t exchange[ELIMINATION_SLOTS];
+
+	// Readiness eventfd, -1 when there is none. Set while the fd is readable or about to be
+	int event_fd;
+	atomic_bool fd_signalled;
+
+	lfqueue_t* lfq;				// VECTOR_MODE_LOCKFREE only
+	spscqueue_t* spsc;			// VECTOR_MODE_SPSC only
+	bool light_notify;			// producers notify with event_notify_light()
+
+#if VECTOR_STATS
+	vector_stats_shard_t stats[STATS_SHARDS];
+	pthread_mutex_t stats_guard;
+	size_t stats_base[VECTOR_STAT_COUNT];	// totals at the last vector_stats_reset()
+#endif
 };
 
+#if VECTOR_STATS
+// Threads take shards round-robin on their first update
+static atomic_uint vector_stats_next_shard;
+static _Thread_local unsigned int vector_stats_shard = UINT32_MAX;
+#endif
+
+// Slot of the exchange array a thread tries first, handed out round-robin
+static atomic_uint vector_exchange_next_slot;
+static _Thread_local unsigned int vector_exchange_slot = UINT32_MAX;
+
+// Deadline that has always passed, turns a blocking pop into vector_try_pop()
+static const struct timespec vector_no_wait = { 0, 0 };
+
 /*
 * FUNCTION DECLARATIONS
 */
 
 vector_t* vector_create(const size_t capacity);
+vector_t* vector_create_sized(size_t capacity, size_t element_size);
+vector_t* vector_create_attr(size_t capacity, const vector_attr_t* attr);
 vector_ret_t vector_destroy(vector_t* vector);
+static int vector_locks_init(vector_t* vector, vector_lock_t lock);
+static void vector_locks_destroy(vector_t* vector);
+static void vector_storage_free(vector_t* vector);
 
 vector_ret_t vector_push(vector_t* vector, void* element);
-static vector_ret_t vector_push_impl(vector_t* vector, void* element);
+vector_ret_t vector_push_copy(vector_t* vector, const void* p_element);
+static vector_ret_t vector_push_impl(vector_t* vector, const void* p_element);
+static vector_ret_t vector_push_lockfree(vector_t* vector, const void* p_element);
 
 vector_ret_t vector_pop(vector_t* vector, void** element);
-static vector_ret_t vector_pop_impl(vector_t* vector, void** element);
+vector_ret_t vector_try_pop(vector_t* vector, void** p_element);
+vector_ret_t vector_pop_until(vector_t* vector, void** p_element, const struct timespec* deadline);
+vector_ret_t vector_pop_copy(vector_t* vector, void* p_element);
+vector_ret_t vector_try_pop_copy(vector_t* vector, void* p_element);
+static vector_ret_t vector_pop_wait(vector_t* vector, void* p_element, const struct timespec* deadline);
+static vector_ret_t vector_pop_impl(vector_t* vector, void* p_element, const struct timespec* deadline);
+static vector_ret_t vector_pop_lockfree(vector_t* vector, void* p_element, const struct timespec* deadline);
+
+vector_ret_t vector_push_n(vector_t* vector, void* const* elements, size_t n);
+vector_ret_t vector_push_n_copy(vector_t* vector, const void* elements, size_t n);
+static vector_ret_t vector_push_n_impl(vector_t* vector, const void* elements, size_t n);
+static vector_ret_t vector_push_n_lockfree(vector_t* vector, const void* elements, size_t n);
+
+vector_ret_t vector_pop_n(vector_t* vector, void** elements, size_t max, size_t* p_popped);
+vector_ret_t vector_pop_n_copy(vector_t* vector, void* elements, size_t max, size_t* p_popped);
+static vector_ret_t vector_pop_n_impl(vector_t* vector, void* elements, size_t max, size_t* p_popped);
+static vector_ret_t vector_pop_n_lockfree(vector_t* vector, void* elements, size_t max, size_t* p_popped);
+
+vector_ret_t vector_reserve(vector_t* vector, vector_slot_t* p_slot);
+vector_ret_t vector_commit(vector_t* vector, vector_slot_t* slot);
+vector_ret_t vector_peek_claim(vector_t* vector, vector_slot_t* p_slot);
+vector_ret_t vector_try_peek_claim(vector_t* vector, vector_slot_t* p_slot);
+static vector_ret_t vector_peek_claim_wait(vector_t* vector, vector_slot_t* p_slot, const struct timespec* deadline);
+vector_ret_t vector_release(vector_t* vector, vector_slot_t* slot);
+static bool vector_take(vector_t* vector, vector_take_t* p_take);
+static bool vector_skip_pending(vector_t* vector, vector_chunk_t* chunk, size_t index);
+static inline bool vector_has_slots(vector_t* vector);
+static vector_slot_node_t* vector_slot_node_get(vector_t* vector);
+static void vector_slot_nodes_destroy(vector_slot_node_t* node);
+
+static inline bool vector_is_lockless(const vector_t* vector);
+static inline vector_ret_t vector_enqueue(vector_t* vector, const void* p_element);
+static inline bool vector_dequeue(vector_t* vector, void* p_element);
+static inline bool vector_holds_pointers(const vector_t* vector);
+static inline unsigned char* vector_cell(const vector_t* vector, vector_chunk_t* chunk, size_t index);
+static inline uint64_t* vector_stamp(const vector_t* vector, unsigned char* cell);
+static inline void vector_copy_in(const vector_t* vector, unsigned char* cells, const void* src, size_t n);
+static inline void vector_copy_out(const vector_t* vector, void* dst, unsigned char* cells, size_t n);
+static inline uint64_t vector_now_ns(void);
+
+static vector_ret_t vector_wait_not_empty(vector_t* vector, const struct timespec* deadline);
+static bool vector_deadline_passed(const struct timespec* deadline);
+static bool vector_spin(vector_t* vector, bool (*ready)(vector_t* vector, void* arg), void* arg,
+						const struct timespec* deadline);
+static bool vector_spin_has_data(vector_t* vector, void* arg);
+static bool vector_spin_dequeue(vector_t* vector, void* arg);
+static inline void vector_count_push(vector_t* vector, size_t n);
+static inline void vector_count_pop(vector_t* vector, size_t n);
+static inline void vector_notify(vector_t* vector, size_t n);
+static inline int vector_lock(vector_t* vector, lock_t* guard);
+static inline int vector_is_empty(vector_t* vector);
+static inline size_t vector_chunk_readable(const vector_t* vector, size_t available);
+static inline void vector_restart_if_empty(vector_t* vector);
+static bool vector_eliminate_push(vector_t* vector, const void* p_element);
+static bool vector_eliminate_pop(vector_t* vector, void* p_element);
+static bool vector_eliminate_wait(vector_t* vector, void* p_element, const struct timespec* deadline);
+static inline unsigned int vector_exchange_first(void);
+static inline void vector_signal_fd(vector_t* vector);
+static void vector_rearm_fd(vector_t* vector);
+
+vector_ret_t vector_presize(vector_t* vector, size_t capacity);
+vector_ret_t vector_get_capacity(vector_t* vector, size_t* p_capacity);
+vector_ret_t vector_get_high_watermark(vector_t* vector, size_t* p_high_watermark);
+vector_ret_t vector_get_allocations(vector_t* vector, size_t* p_allocations);
+vector_ret_t vector_get_latency(vector_t* vector, vector_latency_t* p_latency);
+vector_ret_t vector_get_fd(vector_t* vector, int* p_fd);
 
-static vector_ret_t vector_expand(vector_t* vector);
+vector_ret_t vector_stats(vector_t* vector, vector_stats_t* p_stats);
+vector_ret_t vector_stats_reset(vector_t* vector, vector_stats_t* p_stats);
+#if VECTOR_STATS
+static vector_ret_t vector_stats_collect(vector_t* vector, vector_stats_t* p_stats, bool reset);
+static inline void vector_stat_add(vector_t* vector, vector_stat_t stat, size_t n);
+#endif
 
-static inline size_t vector_next_index(const size_t index, const size_t capacity);
-static inline size_t vector_prev_index(const size_t index, const size_t capacity);
+static vector_ret_t vector_make_room(vector_t* vector, size_t n);
+static size_t vector_missing_room(const vector_t* vector, size_t n);
+static size_t vector_growth_size(const vector_t* vector, size_t min_chunk_size);
+static void vector_link_chunk(vector_t* vector, vector_chunk_t* chunk);
+static vector_chunk_t* vector_shrink(vector_t* vector);
+static vector_chunk_t* vector_unlink_free_chunk(vector_t* vector);
+
+static vector_chunk_t* vector_chunk_create(vector_t* vector, size_t size);
+static void vector_chunk_free(vector_t* vector, vector_chunk_t* chunk);
+static void vector_chunk_destroy_ring(vector_t* vector, vector_chunk_t* chunk);
 
 /*
 * FUNCTION DEFINITIONS
@@ -72,7 +401,69 @@ static inline size_t vector_prev_index(const size_t index, const size_t capacity
 
 vector_t* vector_create(size_t capacity)
 {
-	vector_t* vector = malloc(sizeof(*vector));
+	return vector_create_attr(capacity, NULL);
+}
+
+vector_t* vector_create_sized(size_t capacity, size_t element_size)
+{
+	vector_attr_t attr = { .element_size = element_size };
+
+	return vector_create_attr(capacity, &attr);
+}
+
+vector_t* vector_create_attr(size_t capacity, const vector_attr_t* attr)
+{
+	vector_mode_t mode = (attr == NULL) ? VECTOR_MODE_LOCKED : attr->mode;
+	vector_wait_t wait = (attr == NULL) ? VECTOR_WAIT_PARK : attr->wait;
+	vector_lock_t lock = (attr == NULL) ? VECTOR_LOCK_MUTEX : attr->lock;
+	bool elimination = (attr != NULL && attr->elimination);
+	bool readiness_fd = (attr != NULL && attr->readiness_fd);
+	size_t element_size = (attr == NULL || attr->element_size == 0) ? sizeof(void*) : attr->element_size;
+
+	if (mode < VECTOR_MODE_LOCKED || mode > VECTOR_MODE_SPSC) {
+		debug_print("Unknown vector mode: %d\n", (int)mode);
+		return NULL;
+	}
+
+	if (wait < VECTOR_WAIT_PARK || wait > VECTOR_WAIT_ADAPTIVE) {
+		debug_print("Unknown wait strategy: %d\n", (int)wait);
+		return NULL;
+	}
+
+	if (lock < VECTOR_LOCK_MUTEX || lock > VECTOR_LOCK_MCS ||
+		(lock != VECTOR_LOCK_MUTEX && (mode == VECTOR_MODE_LOCKFREE || mode == VECTOR_MODE_SPSC))) {
+		debug_print("Lock %d does not apply to mode %d\n", (int)lock, (int)mode);
+		return NULL;
+	}
+
+	// The lock-free queue stores pointers only
+	if (mode == VECTOR_MODE_LOCKFREE && element_size != sizeof(void*)) {
+		debug_print("Lock-free vector cannot hold %zu byte elements\n", element_size);
+		return NULL;
+	}
+
+	if (attr != NULL && ((attr->growth_factor != 0 && !(attr->growth_factor > 1.0)) ||
+						 attr->shrink_threshold < 0 || attr->shrink_threshold >= 1.0)) {
+		debug_print("Invalid capacity policy\n");
+		return NULL;
+	}
+
+	// Lock-less modes keep their data outside of the chunk ring
+	if (attr != NULL && (attr->reserve_bytes != 0 || attr->pool != NULL || attr->pool_retain_bytes != 0 || attr->latency ||
+						 elimination || readiness_fd) &&
+		(mode == VECTOR_MODE_LOCKFREE || mode == VECTOR_MODE_SPSC)) {
+		debug_print("Chunk memory options are for chunk ring modes only\n");
+		return NULL;
+	}
+
+	// Eliminated elements never get a push time
+	if (elimination && attr->latency) {
+		debug_print("Elimination and latency mode exclude each other\n");
+		return NULL;
+	}
+
+	// Sides of the vector are aligned to cache lines, so is the size of the struct
+	vector_t* vector = aligned_alloc(CACHE_LINE_SIZE, sizeof(*vector));
 
 	if (vector == NULL)		// condition that malloc() failed
 	{
@@ -80,28 +471,137 @@ vector_t* vector_create(size_t capacity)
 		return NULL;
 	}
 
-	// Allocate one more cell because end index is exclusive
-	vector->element = malloc((capacity + 1) * sizeof(vector->element[0])); 
+	vector->mode = mode;
+	vector->element_size = element_size;
+	vector->cell_size = element_size;
+	vector->latency = NULL;
+	vector->wait = wait;
+	atomic_init(&vector->spin_budget, ADAPTIVE_SPIN_MIN);
+	atomic_init(&vector->pushed, 0);
+	atomic_init(&vector->popped, 0);
+	vector->high_watermark = 0;
+	vector->growth_factor = (attr == NULL || attr->growth_factor == 0) ? DEFAULT_GROWTH_FACTOR : attr->growth_factor;
+	vector->max_growth_step = (attr == NULL) ? 0 : attr->max_growth_step;
+	vector->shrink_threshold = (attr == NULL) ? 0 : attr->shrink_threshold;
+	vector->shrink_delay = (attr == NULL || attr->shrink_delay == 0) ? DEFAULT_SHRINK_DELAY : attr->shrink_delay;
+	vector->low_streak = 0;
+	vector->spare = NULL;
+	vector->begin_chunk = NULL;
+	atomic_init(&vector->pending_n, 0);
+	atomic_init(&vector->ready_n, 0);
+	vector->pending = vector->skipped = vector->ready = vector->ready_tail = vector->free_nodes = NULL;
+	vector->lfq = NULL;
+	vector->spsc = NULL;
+	vector->light_notify = false;
+	vector->elimination = elimination;
+	vector->event_fd = -1;
+	atomic_init(&vector->fd_signalled, false);
+
+	for (size_t slot = 0; slot < ELIMINATION_SLOTS; slot++)
+		atomic_init(&vector->exchange[slot].state, EXCHANGE_EMPTY);
+	vector->arena = NULL;
+	vector->pool = (attr == NULL) ? NULL : attr->pool;
+	vector->own_pool = false;
+	atomic_init(&vector->allocations, 0);
+	event_init(&vector->avail);
+
+#if VECTOR_STATS
+	for (size_t shard = 0; shard < STATS_SHARDS; shard++) {
+		for (size_t stat = 0; stat < VECTOR_STAT_COUNT; stat++)
+			atomic_init(&vector->stats[shard].counter[stat], 0);
+	}
+
+	for (size_t stat = 0; stat < VECTOR_STAT_COUNT; stat++)
+		vector->stats_base[stat] = 0;
+#endif
+
+	if (attr != NULL && attr->reserve_bytes != 0 &&
+		(vector->arena = arena_create(attr->reserve_bytes, attr->huge_pages)) == NULL) {
+		debug_print("Could not reserve address space: %zu\n", attr->reserve_bytes);
+		free(vector);
+		return NULL;
+	}
+
+	// The push time follows the element, cells stay aligned as if they had no stamp
+	if (attr != NULL && attr->latency) {
+		size_t stamped = (element_size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t) + sizeof(uint64_t);
+		vector->cell_size = (stamped + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t);
+
+		if ((vector->latency = histogram_create()) == NULL) {
+			arena_destroy(vector->arena);
+			free(vector);
+			return NULL;
+		}
+	}
+
+	if (vector->pool == NULL && attr != NULL && attr->pool_retain_bytes != 0) {
+		vector->own_pool = true;
+
+		if ((vector->pool = pool_create(attr->pool_retain_bytes)) == NULL) {
+			debug_print("Could not create pool: %zu\n", attr->pool_retain_bytes);
+			histogram_destroy(vector->latency);
+			arena_destroy(vector->arena);
+			free(vector);
+			return NULL;
+		}
+	}
+
+	if (mode == VECTOR_MODE_LOCKFREE) {
+		vector->lfq = lfqueue_create(capacity < LOCKFREE_MIN_SEGMENT_SIZE ? 
+									 LOCKFREE_MIN_SEGMENT_SIZE : capacity);
+		capacity = 0;
+	}
+	else if (mode == VECTOR_MODE_SPSC) {
+		vector->spsc = spscqueue_create(capacity, element_size);
+		vector->light_notify = event_asymmetric_init();
+		capacity = 0;
+	}
+	else {
+		// A chunk needs at least one cell, otherwise the producer could never leave it
+		capacity = (capacity == 0) ? 1 : capacity;
+		vector->begin_chunk = vector_chunk_create(vector, capacity);
+	}
 
-	if (vector->element == NULL)	// condition that malloc() failed
+	if (vector->begin_chunk == NULL && vector->lfq == NULL && vector->spsc == NULL)	// condition that malloc() failed
 	{
 		debug_print("Not enough memory for capacity: %zu\n", capacity);
+
+		if (vector->own_pool)
+			pool_destroy(vector->pool);
+
+		histogram_destroy(vector->latency);
+		arena_destroy(vector->arena);
 		free(vector);
 		return NULL;
 	}
 
-	vector->capacity = capacity;
+	if (vector->begin_chunk != NULL)
+		vector->begin_chunk->next = vector->begin_chunk;	// ring of one chunk
+
+	atomic_init(&vector->capacity, capacity);
+	vector->min_capacity = capacity;
+	vector->first_chunk = vector->begin_chunk;
+	vector->end_chunk = vector->begin_chunk;
 	vector->begin = vector->end = 0;
 
-	if (pthread_mutex_init(&vector->vector_guard, NULL) != 0 ||
-		pthread_cond_init(&vector->avail, NULL) != 0) {
-		debug_print("Could not initialize vector_guard or conditional variable\n");
+	vector->head_guard = &vector->vector_guard;
+	vector->tail_guard = (mode == VECTOR_MODE_TWO_LOCK) ? &vector->tail_lock : &vector->vector_guard;
+
+	// Unwinds itself on failure, only the storage is left to free
+	if (vector_locks_init(vector, lock) != 0) {
+		debug_print("Could not initialize vector locks\n");
+		vector_storage_free(vector);
+		return NULL;
+	}
+
+	if (readiness_fd && (vector->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		debug_print("Could not create readiness eventfd\n");
 		vector_destroy(vector);
 		return NULL;
 	}
 
-	debug_print("Vector elements address: %p with capacity: %zu\n", 
-				vector->element, vector->capacity);
+	debug_print("Vector chunk address: %p with capacity: %zu\n", 
+				(void*)vector->begin_chunk, capacity);
 
 	return vector;
 }
@@ -110,51 +610,153 @@ vector_ret_t vector_destroy(vector_t* vector)
 {
 	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
 
-	pthread_mutex_destroy(&vector->vector_guard);
-	pthread_cond_destroy(&vector->avail);
-
-	free(vector->element);
-	free(vector);
+	vector_locks_destroy(vector);
+	vector_storage_free(vector);
 
 	return VECTOR_SUCCESS;
 }
 
+// Initializes every lock or none: on failure the ones already initialized are destroyed again
+static int vector_locks_init(vector_t* vector, vector_lock_t lock)
+{
+	int ret;
+
+	if ((ret = lock_init(&vector->vector_guard, lock)) != 0)
+		return ret;
+
+	if ((ret = lock_init(&vector->tail_lock, lock)) == 0) {
+		if ((ret = lock_init(&vector->slot_guard, lock)) == 0) {
+#if VECTOR_STATS
+			if ((ret = pthread_mutex_init(&vector->stats_guard, NULL)) == 0)
+				return 0;
+
+			lock_destroy(&vector->slot_guard);
+#else
+			return 0;
+#endif
+		}
+
+		lock_destroy(&vector->tail_lock);
+	}
+
+	lock_destroy(&vector->vector_guard);
+	return ret;
+}
+
+static void vector_locks_destroy(vector_t* vector)
+{
+	lock_destroy(&vector->vector_guard);
+	lock_destroy(&vector->tail_lock);
+	lock_destroy(&vector->slot_guard);
+#if VECTOR_STATS
+	pthread_mutex_destroy(&vector->stats_guard);
+#endif
+}
+
+// Everything vector_create_attr() set up besides the locks, then the vector itself
+static void vector_storage_free(vector_t* vector)
+{
+	if (vector->event_fd >= 0)
+		close(vector->event_fd);
+
+	if (vector->lfq != NULL)
+		lfqueue_destroy(vector->lfq);
+
+	if (vector->spsc != NULL)
+		spscqueue_destroy(vector->spsc);
+
+	if (vector->begin_chunk != NULL)
+		vector_chunk_destroy_ring(vector, vector->begin_chunk);
+
+	vector_slot_nodes_destroy(vector->pending);
+	vector_slot_nodes_destroy(vector->skipped);
+	vector_slot_nodes_destroy(vector->ready);
+	vector_slot_nodes_destroy(vector->free_nodes);
+
+	vector_chunk_free(vector, vector->spare);
+
+	// A private pool may hold chunks of the arena, they go back before it is unmapped
+	if (vector->own_pool) {
+		size_t bytes;
+		void* memory;
+
+		while ((memory = pool_get(vector->pool, 0, &bytes)) != NULL) {
+			if (!arena_free(vector->arena, memory, bytes))
+				free(memory);
+		}
+
+		pool_destroy(vector->pool);
+	}
+
+	histogram_destroy(vector->latency);
+	arena_destroy(vector->arena);
+	free(vector);
+}
+
 vector_ret_t vector_push(vector_t* vector, void* element)
 {
 	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
 
-	if (pthread_mutex_lock(&vector->vector_guard) != 0)
+	if (!vector_holds_pointers(vector))
 		return VECTOR_FAILURE;
 
-	if (vector_push_impl(vector, element) != VECTOR_SUCCESS) {
-		pthread_mutex_unlock(&vector->vector_guard);
-		return VECTOR_FAILURE;
-	}
+	return vector_push_copy(vector, &element);
+}
+
+vector_ret_t vector_push_copy(vector_t* vector, const void* p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	if (vector_is_lockless(vector))
+		return vector_push_lockfree(vector, p_element);
 
-	debug_print("Push: %p at index: %zu\n", 
-		element, 
-		vector_prev_index(vector->end, vector->capacity));
+	// Contended and EMPTY: a consumer may be right there to take the element
+	if (vector->elimination && lock_try_acquire(vector->tail_guard) != 0) {
+		VECTOR_STAT_ADD(vector, VECTOR_STAT_CONTENDED, 1);
 
-	if (pthread_mutex_unlock(&vector->vector_guard) != 0)
+		if (vector_is_empty(vector) && vector_eliminate_push(vector, p_element))
+			return VECTOR_SUCCESS;
+
+		// Already counted as contended
+		if (lock_acquire(vector->tail_guard) != 0)
+			return VECTOR_FAILURE;
+	}
+	else if (!vector->elimination && vector_lock(vector, vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	// The producer lock is already released on failure
+	if (vector_push_impl(vector, p_element) != VECTOR_SUCCESS)
 		return VECTOR_FAILURE;
 
-	if (pthread_cond_signal(&vector->avail) != 0)
+	debug_print("Push: %zu bytes at chunk: %p index: %zu\n", 
+		vector->element_size, 
+		(void*)vector->end_chunk,
+		vector->end - 1);
+
+	if (lock_release(vector->tail_guard) != 0)
 		return VECTOR_FAILURE;
 
+	vector_notify(vector, 1);
+
 	return VECTOR_SUCCESS;
 }
 
-static vector_ret_t vector_push_impl(vector_t* vector, void* element) {
+// Called with the producer lock held, returns without it on failure
+static vector_ret_t vector_push_impl(vector_t* vector, const void* p_element) {
 	// Expand vector first if FULL
-	if (vector_next_index(vector->end, vector->capacity) == vector->begin) {
-		if (vector_expand(vector) != VECTOR_SUCCESS) {
-			debug_print("Could not expand vector\n");
-			return VECTOR_FAILURE;
-		}
+	if (vector_make_room(vector, 1) != VECTOR_SUCCESS) {
+		debug_print("Could not expand vector\n");
+		return VECTOR_FAILURE;
+	}
+
+	if (vector->end == vector->end_chunk->size) {
+		vector->end_chunk = vector->end_chunk->next;
+		vector->end = 0;
 	}
 
-	vector->element[vector->end] = element;								
-	vector->end = vector_next_index(vector->end, vector->capacity);		
+	vector_copy_in(vector, vector_cell(vector, vector->end_chunk, vector->end++), p_element, 1);
+	vector_count_push(vector, 1);
 
 	return VECTOR_SUCCESS;
 }
@@ -164,113 +766,1638 @@ vector_ret_t vector_pop(vector_t* vector, void** p_element)
 	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
 	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
 
-	if (pthread_mutex_lock(&vector->vector_guard) != 0)
+	if (!vector_holds_pointers(vector))
+		return VECTOR_FAILURE;
+
+	return vector_pop_wait(vector, p_element, NULL);
+}
+
+vector_ret_t vector_try_pop(vector_t* vector, void** p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	if (!vector_holds_pointers(vector))
+		return VECTOR_FAILURE;
+
+	vector_ret_t ret = vector_pop_wait(vector, p_element, &vector_no_wait);
+
+	return (ret == VECTOR_TIMEOUT) ? VECTOR_EMPTY : ret;
+}
+
+vector_ret_t vector_pop_until(vector_t* vector, void** p_element, const struct timespec* deadline)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+	CHECK_AND_RETURN_IF_NOT_EXIST(deadline);
+
+	if (!vector_holds_pointers(vector))
 		return VECTOR_FAILURE;
 
-	if (vector_pop_impl(vector, p_element) != 0) {
-		pthread_mutex_unlock(&vector->vector_guard);
+	return vector_pop_wait(vector, p_element, deadline);
+}
+
+vector_ret_t vector_pop_copy(vector_t* vector, void* p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	return vector_pop_wait(vector, p_element, NULL);
+}
+
+vector_ret_t vector_try_pop_copy(vector_t* vector, void* p_element)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_element);
+
+	vector_ret_t ret = vector_pop_wait(vector, p_element, &vector_no_wait);
+
+	return (ret == VECTOR_TIMEOUT) ? VECTOR_EMPTY : ret;
+}
+
+static vector_ret_t vector_pop_wait(vector_t* vector, void* p_element, const struct timespec* deadline)
+{
+	if (vector_is_lockless(vector))
+		return vector_pop_lockfree(vector, p_element, deadline);
+
+	if (vector->elimination && vector_eliminate_wait(vector, p_element, deadline))
+		return VECTOR_SUCCESS;
+
+	// Polling an EMPTY vector, e.g. stealing from it, does not touch the lock
+	if (deadline == &vector_no_wait && !vector_spin_has_data(vector, NULL)) {
+		if (vector->event_fd >= 0)
+			vector_rearm_fd(vector);
+
+		return VECTOR_TIMEOUT;
+	}
+
+	if (vector_lock(vector, vector->head_guard) != 0)
 		return VECTOR_FAILURE;
+
+	vector_ret_t ret = vector_pop_impl(vector, p_element, deadline);
+
+	if (ret != VECTOR_SUCCESS) {
+		lock_release(vector->head_guard);
+
+		if (ret == VECTOR_TIMEOUT && vector->event_fd >= 0)
+			vector_rearm_fd(vector);
+
+		return ret;
 	}
 	
-	debug_print("Pop: %p at index: %zu\n",
-		vector->element[vector_prev_index(vector->begin, vector->capacity)],
-		vector_prev_index(vector->begin, vector->capacity));
+	debug_print("Pop: %zu bytes into: %p\n", vector->element_size, p_element);
 
-	if (pthread_mutex_unlock(&vector->vector_guard) != 0)
+	vector_chunk_t* unlinked = vector_shrink(vector);
+
+	if (lock_release(vector->head_guard) != 0)
 		return VECTOR_FAILURE;
 
+	vector_chunk_free(vector, unlinked);
+
 	return VECTOR_SUCCESS;
 }
 
-static vector_ret_t vector_pop_impl(vector_t* vector, void** p_element) {
-	while (vector->begin == vector->end)  // Vector is EMPTY
-	{
-		if (pthread_cond_wait(&vector->avail, &vector->vector_guard) != 0)
-			return VECTOR_FAILURE;
-	}
+static vector_ret_t vector_pop_impl(vector_t* vector, void* p_element, const struct timespec* deadline) {
+	vector_take_t take;
+
+	// Reserved cells are skipped, so the vector may turn EMPTY again
+	do {
+		vector_ret_t ret = vector_wait_not_empty(vector, deadline);
 
-	*p_element = vector->element[vector->begin];
-	vector->begin = vector_next_index(vector->begin, vector->capacity);
+		if (ret != VECTOR_SUCCESS)
+			return ret;
+	} while (!vector_take(vector, &take));
+
+	vector_copy_out(vector, p_element, take.cell, 1);
+
+	if (take.pinned)
+		atomic_fetch_sub_explicit(&take.chunk->pins, 1, memory_order_release);
+
+	vector_restart_if_empty(vector);
 
 	return VECTOR_SUCCESS;
 }
 
-static vector_ret_t vector_expand(vector_t* vector) {
-	size_t front_idx = vector->begin;
-	size_t end_idx = vector->end;
+vector_ret_t vector_push_n(vector_t* vector, void* const* elements, size_t n)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
 
-	size_t old_capacity = vector->capacity;
+	if (!vector_holds_pointers(vector))
+		return VECTOR_FAILURE;
 
-	size_t new_capacity = (old_capacity == 0) ? 1 : 2 * old_capacity;
+	return vector_push_n_copy(vector, elements, n);
+}
 
-	size_t old_actual_capacity = old_capacity + 1;	// one more cell because 'end' is exlusive
-	size_t new_actual_capacity = new_capacity + 1;	// --||--
+vector_ret_t vector_push_n_copy(vector_t* vector, const void* elements, size_t n)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(elements);
 
-	size_t cell_size = sizeof(vector->element[0]);
+	if (n == 0)
+		return VECTOR_SUCCESS;
 
-	void** old_location = vector->element;
+	if (vector_is_lockless(vector))
+		return vector_push_n_lockfree(vector, elements, n);
 
-	void** new_location = malloc(new_actual_capacity * cell_size);	
+	if (vector_lock(vector, vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
 
-	if (new_location == NULL)
+	// The producer lock is already released on failure
+	if (vector_push_n_impl(vector, elements, n) != VECTOR_SUCCESS)
 		return VECTOR_FAILURE;
 
-	/*since the vector is cyclical, we must ensure that data does not partition incorrectly
-	* e.g. vector of size 3
-	*	   '.' means empty
-	*
-	* e.g. |1|2|3|.| when enlarged becomes |1|2|3|.|.|.|.|.|
-	*       |     |                         |     |
-	*   front[0]  |				       front[0]   |
-	*           end(3)						    end(3)
-	*
-	* Howerver,
-	*
-	*      |3|.|1|2| when enlarged might become  |3|.|1|2|.|.|.|.|
-	*         | |                                   | |
-	*         | front[2]					        | front[2] -- still overflow condition, 
-	*         end(1)						        end(1)        next(end) == front
-	*
-	* so, we need to copy it linearly and reset 'begin' and 'end' indexes
-	*/
+	debug_print("Push: %zu elements\n", n);
 
-	if (front_idx <= end_idx) {
-		memcpy(new_location, old_location, old_actual_capacity * cell_size);
-	}
-	else {
-		// Copy old_location, from 'front_idx' till end, to new_location
-		memcpy(new_location, 
-			old_location + front_idx,							// address of an element at front_idx 
-			(old_actual_capacity - front_idx) * cell_size);		// size of elements starting from front_idx
-		
-		// Continue copying old_location, from beginning till 'end_idx', to new_location
-		memcpy(new_location + (old_actual_capacity - front_idx),
-			old_location,
-			end_idx * cell_size);
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	// Wake one consumer per new element
+	vector_notify(vector, n);
+
+	return VECTOR_SUCCESS;
+}
 
-		end_idx = (old_actual_capacity - front_idx) + end_idx; // vector length
-		front_idx = 0;								
+// Called with the producer lock held, returns without it on failure
+static vector_ret_t vector_push_n_impl(vector_t* vector, const void* elements, size_t n) {
+	const unsigned char* bytes = elements;
+
+	// Second run needs a chunk that fits it entirely, expand at most once
+	if (vector_make_room(vector, n) != VECTOR_SUCCESS) {
+		debug_print("Could not expand vector\n");
+		return VECTOR_FAILURE;
 	}
 
-	free(old_location);
+	// First run goes into whatever is left of 'end_chunk'
+	size_t room = vector->end_chunk->size - vector->end;
+	size_t first = (room < n) ? room : n;
+	size_t rest = n - first;
 
-	// update vector object
-	vector->capacity = new_capacity;
-	vector->begin = front_idx;
-	vector->end = end_idx;
-	vector->element = new_location;
+	vector_copy_in(vector, vector_cell(vector, vector->end_chunk, vector->end), bytes, first);
+	vector->end += first;
+
+	if (rest > 0) {
+		vector->end_chunk = vector->end_chunk->next;
+		vector_copy_in(vector, vector_cell(vector, vector->end_chunk, 0), bytes + first * vector->element_size, rest);
+		vector->end = rest;
+	}
+
+	vector_count_push(vector, n);
 
 	return VECTOR_SUCCESS;
 }
 
-static inline size_t vector_next_index(const size_t index, const size_t capacity)
+vector_ret_t vector_pop_n(vector_t* vector, void** elements, size_t max, size_t* p_popped)
 {
-	// note: actual allocated capacity is 'capacity + 1'
-	return (index + 1) % (capacity + 1);	
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+
+	if (!vector_holds_pointers(vector))
+		return VECTOR_FAILURE;
+
+	return vector_pop_n_copy(vector, elements, max, p_popped);
 }
 
-static inline size_t vector_prev_index(const size_t index, const size_t capacity)
+vector_ret_t vector_pop_n_copy(vector_t* vector, void* elements, size_t max, size_t* p_popped)
 {
-	// note: actual allocated capacity is 'capacity + 1'
-	return index == 0 ? capacity : index - 1; 
-}
\ No newline at end of file
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(elements);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_popped);
+
+	*p_popped = 0;
+
+	if (max == 0)
+		return VECTOR_SUCCESS;
+
+	if (vector_is_lockless(vector))
+		return vector_pop_n_lockfree(vector, elements, max, p_popped);
+
+	if (vector_lock(vector, vector->head_guard) != 0)
+		return VECTOR_FAILURE;
+
+	if (vector_pop_n_impl(vector, elements, max, p_popped) != VECTOR_SUCCESS) {
+		lock_release(vector->head_guard);
+		return VECTOR_FAILURE;
+	}
+
+	debug_print("Pop: %zu elements\n", *p_popped);
+
+	vector_chunk_t* unlinked = vector_shrink(vector);
+
+	if (lock_release(vector->head_guard) != 0)
+		return VECTOR_FAILURE;
+
+	vector_chunk_free(vector, unlinked);
+
+	return VECTOR_SUCCESS;
+}
+
+static vector_ret_t vector_pop_n_impl(vector_t* vector, void* elements, size_t max, size_t* p_popped) {
+	unsigned char* bytes = elements;
+	size_t popped = 0;
+
+	while (popped == 0) {
+		if (vector_wait_not_empty(vector, NULL) != VECTOR_SUCCESS)
+			return VECTOR_FAILURE;
+
+		// Reserved cells may sit among the elements, look at them one by one
+		if (vector_has_slots(vector)) {
+			vector_take_t take;
+
+			while (popped < max && vector_take(vector, &take)) {
+				vector_copy_out(vector, bytes + popped * vector->element_size, take.cell, 1);
+
+				if (take.pinned)
+					atomic_fetch_sub_explicit(&take.chunk->pins, 1, memory_order_release);
+
+				popped++;
+			}
+
+			continue;
+		}
+
+		size_t available = atomic_load_explicit(&vector->pushed, memory_order_acquire) -
+						   atomic_load_explicit(&vector->popped, memory_order_relaxed);
+
+		// Elements span at most two chunks per call: the rest of 'begin_chunk' and the next one
+		for (int run = 0; run < 2 && popped < max && popped < available; run++) {
+			if (vector->begin == vector->begin_chunk->size) {
+				vector->begin_chunk = vector->begin_chunk->next;
+				vector->begin = 0;
+			}
+
+			size_t readable = vector_chunk_readable(vector, available - popped);
+			size_t count = (readable < max - popped) ? readable : max - popped;
+
+			vector_copy_out(vector, bytes + popped * vector->element_size,
+							vector_cell(vector, vector->begin_chunk, vector->begin), count);
+
+			vector->begin += count;
+			popped += count;
+		}
+
+		vector_count_pop(vector, popped);
+	}
+
+	vector_restart_if_empty(vector);
+	*p_popped = popped;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_reserve(vector_t* vector, vector_slot_t* p_slot)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_slot);
+
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	vector_slot_node_t* node = vector_slot_node_get(vector);
+
+	if (node == NULL)
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->tail_guard) != 0) {
+		free(node);
+		return VECTOR_FAILURE;
+	}
+
+	if (vector_make_room(vector, 1) != VECTOR_SUCCESS) {
+		debug_print("Could not expand vector\n");
+		free(node);
+		return VECTOR_FAILURE;
+	}
+
+	if (vector->end == vector->end_chunk->size) {
+		vector->end_chunk = vector->end_chunk->next;
+		vector->end = 0;
+	}
+
+	node->chunk = vector->end_chunk;
+	node->index = vector->end++;
+	atomic_fetch_add_explicit(&node->chunk->pins, 1, memory_order_relaxed);
+
+	// Published before the cell is counted, so consumers reaching it know to skip it
+	lock_acquire(&vector->slot_guard);
+	node->next = vector->pending;
+	vector->pending = node;
+	atomic_fetch_add(&vector->pending_n, 1);
+	lock_release(&vector->slot_guard);
+
+	vector_count_push(vector, 1);
+
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	p_slot->element = vector_cell(vector, node->chunk, node->index);
+	p_slot->internal = node;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_commit(vector_t* vector, vector_slot_t* slot)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(slot);
+	CHECK_AND_RETURN_IF_NOT_EXIST(slot->internal);
+
+	vector_slot_node_t* node = slot->internal;
+	vector_slot_node_t** link;
+	bool passed = false;
+
+	slot->internal = NULL;
+
+	// The element counts as pushed when it is published
+	if (vector->latency != NULL)
+		*vector_stamp(vector, slot->element) = vector_now_ns();
+
+	if (lock_acquire(&vector->slot_guard) != 0)
+		return VECTOR_FAILURE;
+
+	for (link = &vector->pending; *link != NULL && *link != node; link = &(*link)->next)
+		;
+
+	if (*link == NULL) {
+		// Consumers passed it already, it is popped from the 'ready' list instead
+		for (link = &vector->skipped; *link != node; link = &(*link)->next)
+			;
+
+		passed = true;
+	}
+
+	*link = node->next;
+	node->next = NULL;
+
+	if (passed) {
+		if (vector->ready_tail != NULL)
+			vector->ready_tail->next = node;
+		else
+			vector->ready = node;
+
+		vector->ready_tail = node;
+		atomic_fetch_add(&vector->ready_n, 1);
+	}
+	else {
+		// Consumers will read it in place like any other element
+		atomic_fetch_sub(&vector->pending_n, 1);
+		atomic_fetch_sub_explicit(&node->chunk->pins, 1, memory_order_release);
+
+		node->next = vector->free_nodes;
+		vector->free_nodes = node;
+	}
+
+	if (lock_release(&vector->slot_guard) != 0)
+		return VECTOR_FAILURE;
+
+	// vector_reserve() does not wake anyone, the element is readable from now on
+	vector_notify(vector, 1);
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_peek_claim(vector_t* vector, vector_slot_t* p_slot)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_slot);
+
+	return vector_peek_claim_wait(vector, p_slot, NULL);
+}
+
+vector_ret_t vector_try_peek_claim(vector_t* vector, vector_slot_t* p_slot)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_slot);
+
+	vector_ret_t ret = vector_peek_claim_wait(vector, p_slot, &vector_no_wait);
+
+	return (ret == VECTOR_TIMEOUT) ? VECTOR_EMPTY : ret;
+}
+
+static vector_ret_t vector_peek_claim_wait(vector_t* vector, vector_slot_t* p_slot, const struct timespec* deadline)
+{
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->head_guard) != 0)
+		return VECTOR_FAILURE;
+
+	vector_take_t take;
+
+	do {
+		vector_ret_t ret = vector_wait_not_empty(vector, deadline);
+
+		if (ret != VECTOR_SUCCESS) {
+			lock_release(vector->head_guard);
+
+			if (ret == VECTOR_TIMEOUT && vector->event_fd >= 0)
+				vector_rearm_fd(vector);
+
+			return ret;
+		}
+	} while (!vector_take(vector, &take));
+
+	if (vector->latency != NULL)
+		histogram_record(vector->latency, vector_now_ns() - *vector_stamp(vector, take.cell));
+
+	// The cell is read after the lock is gone, keep producers out of its chunk
+	if (!take.pinned)
+		atomic_fetch_add_explicit(&take.chunk->pins, 1, memory_order_relaxed);
+
+	vector_restart_if_empty(vector);
+
+	vector_chunk_t* unlinked = vector_shrink(vector);
+
+	if (lock_release(vector->head_guard) != 0)
+		return VECTOR_FAILURE;
+
+	vector_chunk_free(vector, unlinked);
+
+	p_slot->element = take.cell;
+	p_slot->internal = take.chunk;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_release(vector_t* vector, vector_slot_t* slot)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(slot);
+	CHECK_AND_RETURN_IF_NOT_EXIST(slot->internal);
+
+	vector_chunk_t* chunk = slot->internal;
+
+	slot->internal = NULL;
+	atomic_fetch_sub_explicit(&chunk->pins, 1, memory_order_release);
+
+	return VECTOR_SUCCESS;
+}
+
+/*
+* Find the next element for a consumer, called with the consumer lock held.
+* Counts it as popped. Returns false when only uncommitted cells were left.
+*/
+static bool vector_take(vector_t* vector, vector_take_t* p_take)
+{
+	// Committed after consumers passed them, so they are older than anything in the ring
+	if (atomic_load_explicit(&vector->ready_n, memory_order_acquire) > 0) {
+		lock_acquire(&vector->slot_guard);
+
+		vector_slot_node_t* node = vector->ready;
+
+		if (node != NULL) {
+			vector->ready = node->next;
+
+			if (vector->ready == NULL)
+				vector->ready_tail = NULL;
+
+			atomic_fetch_sub(&vector->ready_n, 1);
+
+			p_take->chunk = node->chunk;
+			p_take->cell = vector_cell(vector, node->chunk, node->index);
+			p_take->pinned = true;
+
+			node->next = vector->free_nodes;
+			vector->free_nodes = node;
+		}
+
+		lock_release(&vector->slot_guard);
+
+		if (node != NULL)
+			return true;
+	}
+
+	while (atomic_load_explicit(&vector->pushed, memory_order_acquire) !=
+		   atomic_load_explicit(&vector->popped, memory_order_relaxed)) {
+		// Not EMPTY, so a drained 'begin_chunk' is followed by more elements
+		if (vector->begin == vector->begin_chunk->size) {
+			vector->begin_chunk = vector->begin_chunk->next;
+			vector->begin = 0;
+		}
+
+		vector_chunk_t* chunk = vector->begin_chunk;
+		size_t index = vector->begin++;
+
+		vector_count_pop(vector, 1);
+
+		// A slow writer must not hold up the elements behind it
+		if (atomic_load_explicit(&vector->pending_n, memory_order_acquire) > 0 &&
+			vector_skip_pending(vector, chunk, index))
+			continue;
+
+		p_take->chunk = chunk;
+		p_take->cell = vector_cell(vector, chunk, index);
+		p_take->pinned = false;
+
+		return true;
+	}
+
+	return false;
+}
+
+// Move a reserved cell that consumers reached before its commit to the 'skipped' list
+static bool vector_skip_pending(vector_t* vector, vector_chunk_t* chunk, size_t index)
+{
+	bool found = false;
+
+	lock_acquire(&vector->slot_guard);
+
+	for (vector_slot_node_t** link = &vector->pending; *link != NULL; link = &(*link)->next) {
+		vector_slot_node_t* node = *link;
+
+		if (node->chunk == chunk && node->index == index) {
+			*link = node->next;
+			node->next = vector->skipped;
+			vector->skipped = node;
+
+			atomic_fetch_sub(&vector->pending_n, 1);
+			found = true;
+			break;
+		}
+	}
+
+	lock_release(&vector->slot_guard);
+
+	return found;
+}
+
+static inline bool vector_has_slots(vector_t* vector)
+{
+	return atomic_load_explicit(&vector->pending_n, memory_order_acquire) != 0 ||
+		   atomic_load_explicit(&vector->ready_n, memory_order_acquire) != 0;
+}
+
+// Nodes are kept for reuse until the vector is destroyed, so reserving does not allocate in the steady state
+static vector_slot_node_t* vector_slot_node_get(vector_t* vector)
+{
+	lock_acquire(&vector->slot_guard);
+
+	vector_slot_node_t* node = vector->free_nodes;
+
+	if (node != NULL)
+		vector->free_nodes = node->next;
+
+	lock_release(&vector->slot_guard);
+
+	return (node != NULL) ? node : malloc(sizeof(*node));
+}
+
+static void vector_slot_nodes_destroy(vector_slot_node_t* node)
+{
+	while (node != NULL) {
+		vector_slot_node_t* next = node->next;
+		free(node);
+		node = next;
+	}
+}
+
+// Called and returns with the consumer lock held, sleeps with it unlocked
+static vector_ret_t vector_wait_not_empty(vector_t* vector, const struct timespec* deadline)
+{
+	while (vector_is_empty(vector))
+	{
+		if (vector_deadline_passed(deadline))
+			return VECTOR_TIMEOUT;
+
+		if (vector->wait != VECTOR_WAIT_PARK) {
+			if (lock_release(vector->head_guard) != 0)
+				return VECTOR_FAILURE;
+
+			bool has_data = vector_spin(vector, vector_spin_has_data, NULL, deadline);
+
+			if (vector_lock(vector, vector->head_guard) != 0)
+				return VECTOR_FAILURE;
+
+			// Another consumer may have taken the data, the spin budget or the deadline ran out
+			if (has_data || !vector_is_empty(vector) || vector_deadline_passed(deadline))
+				continue;
+		}
+
+		/*
+		* Look once more after registering as a sleeper, any later push sees it.
+		* In VECTOR_MODE_LOCKED the mutex already keeps producers out.
+		*/
+		uint32_t key = event_prepare_wait(&vector->avail);
+
+		if (!vector_is_empty(vector)) {
+			event_cancel_wait(&vector->avail);
+			break;
+		}
+
+		if (lock_release(vector->head_guard) != 0) {
+			event_cancel_wait(&vector->avail);
+			return VECTOR_FAILURE;
+		}
+
+		VECTOR_STAT_ADD(vector, VECTOR_STAT_WAITS, 1);
+		event_wait(&vector->avail, key, deadline);
+
+		if (vector_lock(vector, vector->head_guard) != 0)
+			return VECTOR_FAILURE;
+	}
+
+	return VECTOR_SUCCESS;
+}
+
+static bool vector_deadline_passed(const struct timespec* deadline)
+{
+	if (deadline == NULL)
+		return false;
+
+	if (deadline == &vector_no_wait)
+		return true;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec > deadline->tv_sec ||
+		   (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/*
+* Spin phase of the wait strategy, runs without the consumer lock.
+* Returns true as soon as 'ready' reports data, false when the deadline passed
+* or VECTOR_WAIT_ADAPTIVE ran out of its spin budget.
+*/
+static bool vector_spin(vector_t* vector, bool (*ready)(vector_t* vector, void* arg), void* arg,
+						const struct timespec* deadline)
+{
+	switch (vector->wait) {
+	case VECTOR_WAIT_SPIN:
+		for (unsigned spins = 1; !ready(vector, arg); spins++) {
+			if (spins % DEADLINE_CHECK_SPINS == 0 && vector_deadline_passed(deadline))
+				return false;
+
+			cpu_relax();
+		}
+
+		return true;
+
+	case VECTOR_WAIT_YIELD:
+		for (unsigned spins = 0; !ready(vector, arg); spins++) {
+			if (spins % DEADLINE_CHECK_SPINS == 0 && vector_deadline_passed(deadline))
+				return false;
+
+			if (spins < YIELD_SPIN_LIMIT)
+				cpu_relax();
+			else
+				sched_yield();
+		}
+
+		return true;
+
+	case VECTOR_WAIT_ADAPTIVE: {
+		/*
+		* Budget follows twice the spin count that was needed to get data,
+		* and shrinks every time spinning did not help.
+		* Races between consumers only make it less precise.
+		*/
+		unsigned budget = atomic_load_explicit(&vector->spin_budget, memory_order_relaxed);
+
+		for (unsigned spins = 0; spins < budget; spins++) {
+			if (ready(vector, arg)) {
+				int delta = ((int)(2 * spins) - (int)budget) / 8;
+
+				budget = (unsigned)((int)budget + delta);
+				budget = (budget > ADAPTIVE_SPIN_MAX) ? ADAPTIVE_SPIN_MAX : budget;
+				budget = (budget < ADAPTIVE_SPIN_MIN) ? ADAPTIVE_SPIN_MIN : budget;
+				atomic_store_explicit(&vector->spin_budget, budget, memory_order_relaxed);
+				return true;
+			}
+
+			cpu_relax();
+		}
+
+		budget -= budget / 4;
+		budget = (budget < ADAPTIVE_SPIN_MIN) ? ADAPTIVE_SPIN_MIN : budget;
+		atomic_store_explicit(&vector->spin_budget, budget, memory_order_relaxed);
+		return false;
+	}
+
+	default:
+		return false;
+	}
+}
+
+// Ring of chunks readiness: only a hint, the caller checks again under the consumer lock
+static bool vector_spin_has_data(vector_t* vector, void* arg)
+{
+	(void)arg;
+
+	return atomic_load_explicit(&vector->pushed, memory_order_relaxed) != 
+		   atomic_load_explicit(&vector->popped, memory_order_relaxed) ||
+		   atomic_load_explicit(&vector->ready_n, memory_order_relaxed) != 0;
+}
+
+// Lock-less modes readiness: the element is taken right away
+static bool vector_spin_dequeue(vector_t* vector, void* arg)
+{
+	return vector_dequeue(vector, arg);
+}
+
+/*
+* Counters have a single writer, the owner of that side's lock, so no atomic RMW is needed.
+* 'pushed' is published after the elements, consumers know what they may read from it.
+* In VECTOR_MODE_TWO_LOCK it also pairs with a consumer registering as a sleeper
+* without the producer lock, see event.c.
+*/
+static inline void vector_count_push(vector_t* vector, size_t n)
+{
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_PUSHES, n);
+
+	size_t pushed = atomic_load_explicit(&vector->pushed, memory_order_relaxed) + n;
+	size_t length = pushed - atomic_load_explicit(&vector->popped, memory_order_relaxed);
+
+	if (vector->mode == VECTOR_MODE_TWO_LOCK)
+		atomic_store_explicit(&vector->pushed, pushed, memory_order_seq_cst);
+	else
+		atomic_store_explicit(&vector->pushed, pushed, memory_order_release);
+
+	if (length > vector->high_watermark)
+		vector->high_watermark = length;
+}
+
+static inline void vector_count_pop(vector_t* vector, size_t n)
+{
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_POPS, n);
+
+	size_t popped = atomic_load_explicit(&vector->popped, memory_order_relaxed);
+	atomic_store_explicit(&vector->popped, popped + n, memory_order_relaxed);
+}
+
+static inline void vector_notify(vector_t* vector, size_t n)
+{
+	uint32_t wake = n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+
+	if (vector->event_fd >= 0)
+		vector_signal_fd(vector);
+
+	if (vector->light_notify) {
+		event_notify_light(&vector->avail, wake);
+		return;
+	}
+
+	// SPSC enqueue is a plain store, order it before the sleeper check
+	if (vector->mode == VECTOR_MODE_SPSC)
+		atomic_thread_fence(memory_order_seq_cst);
+
+	event_notify(&vector->avail, wake);
+}
+
+/*
+* Edge-coalesced: only the push that finds the flag clear writes to the eventfd.
+* The fences pair with vector_rearm_fd(), either the producer sees the flag cleared
+* or the consumer sees the element.
+*/
+static inline void vector_signal_fd(vector_t* vector)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (atomic_load_explicit(&vector->fd_signalled, memory_order_relaxed) ||
+		atomic_exchange_explicit(&vector->fd_signalled, true, memory_order_relaxed))
+		return;
+
+	uint64_t one = 1;
+
+	while (write(vector->event_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+		;
+}
+
+// A pop found the vector EMPTY: make the fd unreadable, unless data arrived meanwhile
+static void vector_rearm_fd(vector_t* vector)
+{
+	if (!atomic_load_explicit(&vector->fd_signalled, memory_order_relaxed))
+		return;
+
+	uint64_t count;
+
+	while (read(vector->event_fd, &count, sizeof(count)) < 0 && errno == EINTR)
+		;
+
+	atomic_store_explicit(&vector->fd_signalled, false, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (!vector_is_empty(vector))
+		vector_signal_fd(vector);
+}
+
+// Lock a side of the vector, counting the times it was taken already
+static inline int vector_lock(vector_t* vector, lock_t* guard)
+{
+#if VECTOR_STATS
+	if (lock_try_acquire(guard) == 0)
+		return 0;
+
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_CONTENDED, 1);
+#else
+	(void)vector;
+#endif
+
+	return lock_acquire(guard);
+}
+
+// Needs the consumer lock only, elements are counted in the order they sit in the ring
+static inline int vector_is_empty(vector_t* vector)
+{
+	return atomic_load_explicit(&vector->pushed, memory_order_seq_cst) ==
+		   atomic_load_explicit(&vector->popped, memory_order_relaxed) &&
+		   atomic_load_explicit(&vector->ready_n, memory_order_seq_cst) == 0;
+}
+
+// Number of the `available` elements that can be read from 'begin_chunk' without moving to the next chunk
+static inline size_t vector_chunk_readable(const vector_t* vector, size_t available)
+{
+	size_t limit = vector->begin_chunk->size - vector->begin;
+
+	return (available < limit) ? available : limit;
+}
+
+/*
+* Restart an EMPTY chunk from its first cell, so it is not left for the next lap.
+* Moves the producer's 'end' too, so VECTOR_MODE_LOCKED only, and not over pinned cells.
+*/
+static inline void vector_restart_if_empty(vector_t* vector)
+{
+	if (vector->mode == VECTOR_MODE_LOCKED && vector_is_empty(vector) &&
+		atomic_load_explicit(&vector->begin_chunk->pins, memory_order_acquire) == 0)
+		vector->begin = vector->end = 0;
+}
+
+/*
+* Offer the element in an exchange slot for a while.
+* Returns true when a consumer took it, false when nobody came and the element must go to the ring.
+*/
+static bool vector_eliminate_push(vector_t* vector, const void* p_element)
+{
+	vector_exchange_t* exchange = &vector->exchange[vector_exchange_first()];
+	unsigned int state = EXCHANGE_EMPTY;
+
+	if (!atomic_compare_exchange_strong_explicit(&exchange->state, &state, EXCHANGE_OFFERING,
+												 memory_order_relaxed, memory_order_relaxed))
+		return false;
+
+	exchange->element = p_element;
+	atomic_store_explicit(&exchange->state, EXCHANGE_OFFERED, memory_order_release);
+
+	for (unsigned int spins = 0; spins < ELIMINATION_SPINS; spins++) {
+		if (atomic_load_explicit(&exchange->state, memory_order_acquire) == EXCHANGE_DONE)
+			break;
+
+		cpu_relax();
+	}
+
+	// Withdraw, unless a consumer claimed the element in the meantime
+	state = EXCHANGE_OFFERED;
+	if (atomic_compare_exchange_strong_explicit(&exchange->state, &state, EXCHANGE_EMPTY,
+												memory_order_relaxed, memory_order_relaxed))
+		return false;
+
+	// The consumer is copying, or put the offer back when it saw data in the ring
+	for (unsigned int spins = 0; ; spins++) {
+		state = atomic_load_explicit(&exchange->state, memory_order_acquire);
+
+		if (state == EXCHANGE_DONE)
+			break;
+
+		if (state == EXCHANGE_OFFERED &&
+			atomic_compare_exchange_strong_explicit(&exchange->state, &state, EXCHANGE_EMPTY,
+													memory_order_relaxed, memory_order_relaxed))
+			return false;
+
+		if (spins < YIELD_SPIN_LIMIT)
+			cpu_relax();
+		else
+			sched_yield();
+	}
+
+	atomic_store_explicit(&exchange->state, EXCHANGE_EMPTY, memory_order_relaxed);
+
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_PUSHES, 1);
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_ELIMINATED, 1);
+
+	return true;
+}
+
+/*
+* Take an offered element, if the ring is still EMPTY once it is claimed:
+* the push and the pop then both happen at that instant, with nothing queued before them.
+*/
+static bool vector_eliminate_pop(vector_t* vector, void* p_element)
+{
+	unsigned int first = vector_exchange_first();
+
+	for (unsigned int i = 0; i < ELIMINATION_SLOTS; i++) {
+		vector_exchange_t* exchange = &vector->exchange[(first + i) % ELIMINATION_SLOTS];
+		unsigned int state = EXCHANGE_OFFERED;
+
+		if (atomic_load_explicit(&exchange->state, memory_order_relaxed) != EXCHANGE_OFFERED ||
+			!atomic_compare_exchange_strong_explicit(&exchange->state, &state, EXCHANGE_CLAIMED,
+													 memory_order_acquire, memory_order_relaxed))
+			continue;
+
+		if (!vector_is_empty(vector)) {
+			atomic_store_explicit(&exchange->state, EXCHANGE_OFFERED, memory_order_relaxed);
+			return false;
+		}
+
+		memcpy(p_element, exchange->element, vector->element_size);
+		atomic_store_explicit(&exchange->state, EXCHANGE_DONE, memory_order_release);
+
+		VECTOR_STAT_ADD(vector, VECTOR_STAT_POPS, 1);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+* A consumer that finds the ring EMPTY watches the exchange slots for a while before it takes the lock,
+* so it is still there when a contended producer makes its offer. Polls once only for vector_try_pop().
+* Returns true with an element taken from a producer, false when data showed up in the ring or nobody offered.
+*/
+static bool vector_eliminate_wait(vector_t* vector, void* p_element, const struct timespec* deadline)
+{
+	unsigned int rounds = (deadline == &vector_no_wait) ? 1 : ELIMINATION_SPINS;
+
+	for (unsigned int spins = 0; spins < rounds; spins++) {
+		if (vector_spin_has_data(vector, NULL))
+			return false;
+
+		if (vector_eliminate_pop(vector, p_element))
+			return true;
+
+		cpu_relax();
+	}
+
+	return false;
+}
+
+static inline unsigned int vector_exchange_first(void)
+{
+	if (vector_exchange_slot == UINT32_MAX)
+		vector_exchange_slot = atomic_fetch_add_explicit(&vector_exchange_next_slot, 1, memory_order_relaxed) %
+							   ELIMINATION_SLOTS;
+
+	return vector_exchange_slot;
+}
+
+// VECTOR_MODE_LOCKFREE and VECTOR_MODE_SPSC keep their data outside of the chunk ring
+static inline bool vector_is_lockless(const vector_t* vector)
+{
+	return vector->mode == VECTOR_MODE_LOCKFREE || vector->mode == VECTOR_MODE_SPSC;
+}
+
+static inline vector_ret_t vector_enqueue(vector_t* vector, const void* p_element)
+{
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_PUSHES, 1);
+
+	if (vector->mode == VECTOR_MODE_SPSC)
+		return spscqueue_enqueue(vector->spsc, p_element);
+
+	void* element;
+	memcpy(&element, p_element, sizeof(element));
+
+	return lfqueue_enqueue(vector->lfq, element);
+}
+
+static inline bool vector_dequeue(vector_t* vector, void* p_element)
+{
+	if (vector->mode == VECTOR_MODE_SPSC) {
+		if (!spscqueue_dequeue(vector->spsc, p_element))
+			return false;
+	}
+	else {
+		void* element;
+
+		if (!lfqueue_dequeue(vector->lfq, &element))
+			return false;
+
+		memcpy(p_element, &element, sizeof(element));
+	}
+
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_POPS, 1);
+
+	return true;
+}
+
+static inline bool vector_holds_pointers(const vector_t* vector)
+{
+	if (vector->element_size == sizeof(void*))
+		return true;
+
+	debug_print("Vector holds %zu byte elements, use the _copy functions\n", vector->element_size);
+	return false;
+}
+
+static inline unsigned char* vector_cell(const vector_t* vector, vector_chunk_t* chunk, size_t index)
+{
+	return chunk->cell + index * vector->cell_size;
+}
+
+// Push time of the element in a cell, latency mode only
+static inline uint64_t* vector_stamp(const vector_t* vector, unsigned char* cell)
+{
+	return (uint64_t*)(cell + vector->cell_size - sizeof(uint64_t));
+}
+
+// Copy `n` elements into consecutive cells of a chunk
+static inline void vector_copy_in(const vector_t* vector, unsigned char* cells, const void* src, size_t n)
+{
+	const unsigned char* bytes = src;
+
+	if (vector->latency == NULL) {
+		// A single pointer is the common case, a constant size lets the compiler inline the copy
+		if (n == 1 && vector->element_size == sizeof(void*))
+			memcpy(cells, src, sizeof(void*));
+		else
+			memcpy(cells, src, n * vector->element_size);
+
+		return;
+	}
+
+	uint64_t now = vector_now_ns();
+
+	for (size_t idx = 0; idx < n; idx++) {
+		unsigned char* cell = cells + idx * vector->cell_size;
+
+		memcpy(cell, bytes + idx * vector->element_size, vector->element_size);
+		*vector_stamp(vector, cell) = now;
+	}
+}
+
+// Copy `n` elements out of consecutive cells of a chunk
+static inline void vector_copy_out(const vector_t* vector, void* dst, unsigned char* cells, size_t n)
+{
+	unsigned char* bytes = dst;
+
+	if (vector->latency == NULL) {
+		if (n == 1 && vector->element_size == sizeof(void*))
+			memcpy(dst, cells, sizeof(void*));
+		else
+			memcpy(dst, cells, n * vector->element_size);
+
+		return;
+	}
+
+	uint64_t now = vector_now_ns();
+
+	for (size_t idx = 0; idx < n; idx++) {
+		unsigned char* cell = cells + idx * vector->cell_size;
+
+		memcpy(bytes + idx * vector->element_size, cell, vector->element_size);
+		histogram_record(vector->latency, now - *vector_stamp(vector, cell));
+	}
+}
+
+static inline uint64_t vector_now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static vector_ret_t vector_push_lockfree(vector_t* vector, const void* p_element)
+{
+	if (vector_enqueue(vector, p_element) != VECTOR_SUCCESS)
+		return VECTOR_FAILURE;
+
+	debug_print("Push: %zu bytes\n", vector->element_size);
+
+	vector_notify(vector, 1);
+
+	return VECTOR_SUCCESS;
+}
+
+static vector_ret_t vector_pop_lockfree(vector_t* vector, void* p_element, const struct timespec* deadline)
+{
+	for (;;) {
+		if (vector_dequeue(vector, p_element))
+			break;
+
+		if (vector_deadline_passed(deadline))
+			return VECTOR_TIMEOUT;
+
+		if (vector->wait != VECTOR_WAIT_PARK && vector_spin(vector, vector_spin_dequeue, p_element, deadline))
+			break;
+
+		// Vector is EMPTY, look once more after registering as a sleeper
+		uint32_t key = vector->light_notify ? event_prepare_wait_heavy(&vector->avail) :
+											  event_prepare_wait(&vector->avail);
+
+		if (vector_dequeue(vector, p_element)) {
+			event_cancel_wait(&vector->avail);
+			break;
+		}
+
+		VECTOR_STAT_ADD(vector, VECTOR_STAT_WAITS, 1);
+		event_wait(&vector->avail, key, deadline);
+	}
+
+	debug_print("Pop: %zu bytes into: %p\n", vector->element_size, p_element);
+
+	return VECTOR_SUCCESS;
+}
+
+static vector_ret_t vector_push_n_lockfree(vector_t* vector, const void* elements, size_t n)
+{
+	const unsigned char* bytes = elements;
+
+	for (size_t idx = 0; idx < n; idx++) {
+		if (vector_enqueue(vector, bytes + idx * vector->element_size) != VECTOR_SUCCESS) {
+			vector_notify(vector, idx);
+			return VECTOR_FAILURE;
+		}
+	}
+
+	vector_notify(vector, n);
+
+	return VECTOR_SUCCESS;
+}
+
+static vector_ret_t vector_pop_n_lockfree(vector_t* vector, void* elements, size_t max, size_t* p_popped)
+{
+	unsigned char* bytes = elements;
+
+	// Block for the first element only, then take what is already there
+	if (vector_pop_lockfree(vector, bytes, NULL) != VECTOR_SUCCESS)
+		return VECTOR_FAILURE;
+
+	size_t popped = 1;
+
+	while (popped < max && vector_dequeue(vector, bytes + popped * vector->element_size))
+		popped++;
+
+	*p_popped = popped;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_presize(vector_t* vector, size_t capacity)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	size_t current = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+	size_t missing = (current < capacity) ? capacity - current : 0;
+
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	vector_chunk_t* chunk = NULL;
+
+	if (missing > 0 && (chunk = vector_chunk_create(vector, missing)) == NULL)
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->tail_guard) != 0) {
+		vector_chunk_free(vector, chunk);
+		return VECTOR_FAILURE;
+	}
+
+	if (chunk != NULL)
+		vector_link_chunk(vector, chunk);
+
+	if (vector->min_capacity < capacity)
+		vector->min_capacity = capacity;
+
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_get_capacity(vector_t* vector, size_t* p_capacity)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_capacity);
+
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	*p_capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_get_high_watermark(vector_t* vector, size_t* p_high_watermark)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_high_watermark);
+
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	if (vector_lock(vector, vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	*p_high_watermark = vector->high_watermark;
+
+	if (lock_release(vector->tail_guard) != 0)
+		return VECTOR_FAILURE;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_get_fd(vector_t* vector, int* p_fd)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_fd);
+
+	if (vector->event_fd < 0)
+		return VECTOR_FAILURE;
+
+	*p_fd = vector->event_fd;
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_get_allocations(vector_t* vector, size_t* p_allocations)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_allocations);
+
+	if (vector_is_lockless(vector))
+		return VECTOR_FAILURE;
+
+	*p_allocations = atomic_load_explicit(&vector->allocations, memory_order_relaxed);
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_get_latency(vector_t* vector, vector_latency_t* p_latency)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_latency);
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector->latency);
+
+	p_latency->count = histogram_count(vector->latency);
+	p_latency->p50_ns = histogram_percentile(vector->latency, 50.0);
+	p_latency->p99_ns = histogram_percentile(vector->latency, 99.0);
+	p_latency->p999_ns = histogram_percentile(vector->latency, 99.9);
+	p_latency->max_ns = histogram_max(vector->latency);
+
+	return VECTOR_SUCCESS;
+}
+
+vector_ret_t vector_stats(vector_t* vector, vector_stats_t* p_stats)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_stats);
+
+#if VECTOR_STATS
+	return vector_stats_collect(vector, p_stats, false);
+#else
+	return VECTOR_FAILURE;
+#endif
+}
+
+vector_ret_t vector_stats_reset(vector_t* vector, vector_stats_t* p_stats)
+{
+	CHECK_AND_RETURN_IF_NOT_EXIST(vector);
+	CHECK_AND_RETURN_IF_NOT_EXIST(p_stats);
+
+#if VECTOR_STATS
+	return vector_stats_collect(vector, p_stats, true);
+#else
+	return VECTOR_FAILURE;
+#endif
+}
+
+#if VECTOR_STATS
+static vector_ret_t vector_stats_collect(vector_t* vector, vector_stats_t* p_stats, bool reset)
+{
+	size_t total[VECTOR_STAT_COUNT] = { 0 };
+	size_t delta[VECTOR_STAT_COUNT];
+
+	// Summed under the lock, so a total is never older than the base a concurrent reset stored
+	if (pthread_mutex_lock(&vector->stats_guard) != 0)
+		return VECTOR_FAILURE;
+
+	for (size_t shard = 0; shard < STATS_SHARDS; shard++) {
+		for (size_t stat = 0; stat < VECTOR_STAT_COUNT; stat++)
+			total[stat] += atomic_load_explicit(&vector->stats[shard].counter[stat], memory_order_relaxed);
+	}
+
+	for (size_t stat = 0; stat < VECTOR_STAT_COUNT; stat++) {
+		delta[stat] = total[stat] - vector->stats_base[stat];
+
+		if (reset)
+			vector->stats_base[stat] = total[stat];
+	}
+
+	if (pthread_mutex_unlock(&vector->stats_guard) != 0)
+		return VECTOR_FAILURE;
+
+	p_stats->pushes = delta[VECTOR_STAT_PUSHES];
+	p_stats->pops = delta[VECTOR_STAT_POPS];
+	p_stats->expansions = delta[VECTOR_STAT_EXPANSIONS];
+	p_stats->bytes_allocated = delta[VECTOR_STAT_BYTES_ALLOCATED];
+	p_stats->lock_contended = delta[VECTOR_STAT_CONTENDED];
+	p_stats->waits = delta[VECTOR_STAT_WAITS];
+	p_stats->eliminated = delta[VECTOR_STAT_ELIMINATED];
+
+	if (vector_is_lockless(vector)) {
+		// Counted apart, so a pop may be seen before its push
+		size_t pushes = total[VECTOR_STAT_PUSHES];
+		size_t pops = total[VECTOR_STAT_POPS];
+
+		p_stats->depth = (pushes > pops) ? pushes - pops : 0;
+		p_stats->high_watermark = 0;
+		p_stats->capacity = 0;
+	}
+	else {
+		if (lock_acquire(vector->tail_guard) != 0)
+			return VECTOR_FAILURE;
+
+		p_stats->depth = atomic_load_explicit(&vector->pushed, memory_order_relaxed) -
+						 atomic_load_explicit(&vector->popped, memory_order_relaxed);
+		p_stats->high_watermark = vector->high_watermark;
+		p_stats->capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+
+		if (lock_release(vector->tail_guard) != 0)
+			return VECTOR_FAILURE;
+	}
+
+	return VECTOR_SUCCESS;
+}
+
+static inline void vector_stat_add(vector_t* vector, vector_stat_t stat, size_t n)
+{
+	if (vector_stats_shard == UINT32_MAX)
+		vector_stats_shard = atomic_fetch_add_explicit(&vector_stats_next_shard, 1, memory_order_relaxed) % STATS_SHARDS;
+
+	atomic_fetch_add_explicit(&vector->stats[vector_stats_shard].counter[stat], n, memory_order_relaxed);
+}
+#endif
+
+/*
+* Make sure `n` elements can be pushed without allocating.
+* Called with the producer lock held, allocates with it unlocked.
+* Returns with the lock held on success only: on failure it is released, or could not be taken back.
+*
+* e.g. vector of size 4 made of one chunk
+*	   '.' means empty
+*
+*      |5|6|3|4| -- 'end' reached the chunk end and the next chunk is 'begin_chunk'
+*           |
+*         begin
+*
+* becomes
+*
+*      |5|6|3|4| -> |.|.|.|.| -> back to the first chunk
+*           |       |
+*         begin    end (after the push moves to the new chunk)
+*
+* Elements already in the vector stay where they are
+*/
+static vector_ret_t vector_make_room(vector_t* vector, size_t n)
+{
+	size_t missing;
+
+	while ((missing = vector_missing_room(vector, n)) > 0) {
+		if (vector->spare != NULL && vector->spare->size >= missing) {
+			vector_link_chunk(vector, vector->spare);
+			vector->spare = NULL;
+			break;
+		}
+
+		size_t new_chunk_size = vector_growth_size(vector, missing);
+
+		if (lock_release(vector->tail_guard) != 0)
+			return VECTOR_FAILURE;
+
+		vector_chunk_t* new_chunk = vector_chunk_create(vector, new_chunk_size);
+
+		if (new_chunk == NULL)
+			return VECTOR_FAILURE;
+
+		if (vector_lock(vector, vector->tail_guard) != 0) {
+			vector_chunk_free(vector, new_chunk);
+			return VECTOR_FAILURE;
+		}
+
+		// Other threads ran meanwhile, keep the larger chunk as spare and look again
+		if (vector->spare == NULL || vector->spare->size < new_chunk->size) {
+			vector_chunk_t* old_spare = vector->spare;
+			vector->spare = new_chunk;
+			new_chunk = old_spare;
+		}
+
+		vector_chunk_free(vector, new_chunk);
+	}
+
+	return VECTOR_SUCCESS;
+}
+
+/*
+* Size of the chunk that has to be linked after 'end_chunk' to push `n` elements,
+* 0 when there is enough room already.
+* Elements that do not fit into 'end_chunk' go to the next chunk, which must be free and large enough.
+*/
+static size_t vector_missing_room(const vector_t* vector, size_t n)
+{
+	size_t room = vector->end_chunk->size - vector->end;
+
+	if (n <= room)
+		return 0;
+
+	size_t rest = n - room;
+	vector_chunk_t* next = vector->end_chunk->next;
+
+	if (next != vector->begin_chunk && next->size >= rest &&
+		atomic_load_explicit(&next->pins, memory_order_acquire) == 0)
+		return 0;
+
+	return rest;
+}
+
+static size_t vector_growth_size(const vector_t* vector, size_t min_chunk_size)
+{
+	size_t capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+	size_t size = (size_t)((double)capacity * (vector->growth_factor - 1.0));
+
+	if (vector->max_growth_step != 0 && size > vector->max_growth_step)
+		size = vector->max_growth_step;
+
+	if (size < min_chunk_size)
+		size = min_chunk_size;
+
+	return (size == 0) ? 1 : size;
+}
+
+static void vector_link_chunk(vector_t* vector, vector_chunk_t* chunk)
+{
+	VECTOR_STAT_ADD(vector, VECTOR_STAT_EXPANSIONS, 1);
+
+	chunk->next = vector->end_chunk->next;
+	vector->end_chunk->next = chunk;
+
+	size_t capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed) + chunk->size;
+	atomic_store_explicit(&vector->capacity, capacity, memory_order_relaxed);
+
+	debug_print("Vector expanded to capacity: %zu\n", capacity);
+}
+
+/*
+* Unlink a free chunk once occupancy stayed below the threshold for 'shrink_delay' pops.
+* Called with the consumer lock held, the caller frees the returned chunk after unlocking it.
+*/
+static vector_chunk_t* vector_shrink(vector_t* vector)
+{
+	if (vector->shrink_threshold == 0)
+		return NULL;
+
+	size_t capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+	size_t length = atomic_load_explicit(&vector->pushed, memory_order_relaxed) -
+					atomic_load_explicit(&vector->popped, memory_order_relaxed);
+
+	if ((double)length >= vector->shrink_threshold * (double)capacity) {
+		vector->low_streak = 0;
+		return NULL;
+	}
+
+	if (++vector->low_streak < vector->shrink_delay)
+		return NULL;
+
+	vector->low_streak = 0;
+
+	// The producer side changes too, rather try again later than wait for a producer
+	bool two_locks = (vector->tail_guard != vector->head_guard);
+
+	if (two_locks && lock_try_acquire(vector->tail_guard) != 0)
+		return NULL;
+
+	vector_chunk_t* victim = vector_unlink_free_chunk(vector);
+
+	if (two_locks)
+		lock_release(vector->tail_guard);
+
+	return victim;
+}
+
+// Called with both locks held
+static vector_chunk_t* vector_unlink_free_chunk(vector_t* vector)
+{
+	size_t capacity = atomic_load_explicit(&vector->capacity, memory_order_relaxed);
+
+	if (vector->spare != NULL) {
+		vector_chunk_t* spare = vector->spare;
+		vector->spare = NULL;
+		return spare;
+	}
+
+	// An EMPTY vector may restart from its smallest unpinned chunk, so the larger ones become free.
+	// The first chunk always stays, so the vector can shrink back to it
+	if (vector_is_empty(vector)) {
+		vector_chunk_t* smallest = NULL;
+		vector_chunk_t* chunk = vector->end_chunk;
+
+		do {
+			if (atomic_load_explicit(&chunk->pins, memory_order_acquire) == 0 &&
+				(smallest == NULL || chunk->size < smallest->size))
+				smallest = chunk;
+
+			chunk = chunk->next;
+		} while (chunk != vector->end_chunk);
+
+		if (smallest != NULL) {
+			vector->begin_chunk = vector->end_chunk = smallest;
+			vector->begin = vector->end = 0;
+		}
+	}
+
+	// Chunks from 'end_chunk->next' up to 'begin_chunk' hold no elements, unlink the largest allowed one
+	vector_chunk_t* victim_prev = NULL;
+
+	for (vector_chunk_t* prev = vector->end_chunk; prev->next != vector->begin_chunk; prev = prev->next) {
+		vector_chunk_t* chunk = prev->next;
+
+		if (chunk != vector->first_chunk && 
+			atomic_load_explicit(&chunk->pins, memory_order_acquire) == 0 &&
+			capacity - chunk->size >= vector->min_capacity &&
+			(victim_prev == NULL || chunk->size > victim_prev->next->size))
+			victim_prev = prev;
+	}
+
+	if (victim_prev == NULL)
+		return NULL;
+
+	vector_chunk_t* victim = victim_prev->next;
+
+	victim_prev->next = victim->next;
+	capacity -= victim->size;
+	atomic_store_explicit(&vector->capacity, capacity, memory_order_relaxed);
+
+	debug_print("Vector shrunk to capacity: %zu\n", capacity);
+
+	return victim;
+}
+
+// Reused from the pool, else carved from the reserved address space while it lasts, then from malloc()
+static vector_chunk_t* vector_chunk_create(vector_t* vector, size_t size)
+{
+	if (size > (SIZE_MAX - sizeof(vector_chunk_t)) / vector->cell_size)
+		return NULL;
+
+	size_t bytes = sizeof(vector_chunk_t) + size * vector->cell_size;
+	vector_chunk_t* chunk = NULL;
+
+	if (vector->pool != NULL && (chunk = pool_get(vector->pool, bytes, &bytes)) != NULL) {
+		// A larger chunk than asked for, its extra cells are used too
+		size = (bytes - sizeof(vector_chunk_t)) / vector->cell_size;
+	}
+	else {
+		if (vector->arena != NULL)
+			chunk = arena_alloc(vector->arena, bytes);
+
+		if (chunk == NULL)
+			chunk = malloc(bytes);
+
+		if (chunk == NULL)
+			return NULL;
+
+		atomic_fetch_add_explicit(&vector->allocations, 1, memory_order_relaxed);
+		VECTOR_STAT_ADD(vector, VECTOR_STAT_BYTES_ALLOCATED, bytes);
+	}
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->alloc_bytes = bytes;
+	atomic_init(&chunk->pins, 0);
+
+	return chunk;
+}
+
+static void vector_chunk_free(vector_t* vector, vector_chunk_t* chunk)
+{
+	if (chunk == NULL)
+		return;
+
+	// A shared pool may outlive the arena
+	if (vector->pool != NULL && (vector->own_pool || !arena_owns(vector->arena, chunk)) &&
+		pool_put(vector->pool, chunk, chunk->alloc_bytes))
+		return;
+
+	if (!arena_free(vector->arena, chunk, chunk->alloc_bytes))
+		free(chunk);
+}
+
+static void vector_chunk_destroy_ring(vector_t* vector, vector_chunk_t* chunk)
+{
+	vector_chunk_t* first = chunk;
+
+	do {
+		vector_chunk_t* next = chunk->next;
+		vector_chunk_free(vector, chunk);
+		chunk = next;
+	} while (chunk != first);
+}
@@ -2,17 +2,167 @@
 #define VECTOR_H
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 #define DEBUG 0
 
+// Runtime statistics, see vector_stats(). Build with -DVECTOR_STATS=0 to compile them out
+#ifndef VECTOR_STATS
+#define VECTOR_STATS 1
+#endif
+
 typedef struct vector_t vector_t;
+typedef struct pool_t pool_t;		// see pool.h
 
 typedef enum vector_ret_t
 {
 	VECTOR_SUCCESS = 0,
-	VECTOR_FAILURE = 1
+	VECTOR_FAILURE = 1,
+	VECTOR_EMPTY = 2,		// vector_try_pop() found nothing
+	VECTOR_TIMEOUT = 3		// vector_pop_until() deadline passed
 } vector_ret_t;
 
+typedef enum vector_mode_t
+{
+	VECTOR_MODE_LOCKED = 0,		// ring of chunks guarded by a mutex
+	VECTOR_MODE_LOCKFREE = 1,	// linked segments with atomic head/tail tickets
+	VECTOR_MODE_TWO_LOCK = 2,	// ring of chunks, producers and consumers lock separate ends
+	VECTOR_MODE_SPSC = 3		// one producer and one consumer thread, no locks and no atomic RMW
+} vector_mode_t;
+
+/*
+* What a consumer does while the vector is EMPTY.
+*/
+typedef enum vector_wait_t
+{
+	VECTOR_WAIT_PARK = 0,		// sleep in the kernel at once, no CPU burnt
+	VECTOR_WAIT_SPIN = 1,		// spin with a pause instruction, never sleep
+	VECTOR_WAIT_YIELD = 2,		// spin for a while, then sched_yield() in a loop
+	VECTOR_WAIT_ADAPTIVE = 3	// spin for a learned budget, then sleep
+} vector_wait_t;
+
+/*
+* Lock guarding the sides of the chunk ring, VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+* Spinning locks suit short critical sections on dedicated cores,
+* sleeping ones suit more threads than cores.
+*/
+typedef enum vector_lock_t
+{
+	VECTOR_LOCK_MUTEX = 0,		// pthread mutex
+	VECTOR_LOCK_ADAPTIVE = 1,	// pthread mutex that spins briefly before sleeping
+	VECTOR_LOCK_TTAS = 2,		// test and test-and-set spinlock
+	VECTOR_LOCK_TICKET = 3,		// FIFO spinlock
+	VECTOR_LOCK_MCS = 4			// FIFO queue lock, every waiter spins on its own cache line
+} vector_lock_t;
+
+/*
+* Vector creation attributes.
+* Zero-initialized attributes select the default behaviour.
+*/
+typedef struct vector_attr_t
+{
+	vector_mode_t mode;
+	vector_wait_t wait;
+	vector_lock_t lock;
+
+	/*
+	* Capacity policy, VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+	* Capacity never shrinks below the created or pre-sized capacity.
+	*/
+	double growth_factor;		// capacity is multiplied by it on overflow, 0 means 2
+	size_t max_growth_step;		// at most that many cells are added per overflow, 0 means no limit
+	double shrink_threshold;	// shrink when occupancy stays below this share of capacity, 0 means never
+	size_t shrink_delay;		// that many pops in a row must see low occupancy, 0 means 1024
+
+	/*
+	* Bytes copied into the vector per element, 0 means sizeof(void*).
+	* Other sizes need the _copy functions and are not for VECTOR_MODE_LOCKFREE.
+	*/
+	size_t element_size;
+
+	/*
+	* Address space reserved up front, VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+	* Chunks are carved from it and its pages are committed as the vector grows,
+	* malloc() takes over once it is used up. 0 means malloc() only.
+	*/
+	size_t reserve_bytes;
+	bool huge_pages;			// back the reserved range with transparent huge pages
+
+	/*
+	* Freed chunks are kept for reuse instead of going back to the allocator,
+	* VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+	* 'pool' is shared with other vectors and must outlive them, chunks from
+	* reserved address space are not put in it. Otherwise a private pool
+	* keeps up to 'pool_retain_bytes', 0 means no pool.
+	*/
+	pool_t* pool;
+	size_t pool_retain_bytes;
+
+	/*
+	* Stamp elements with CLOCK_MONOTONIC on push and record the time until their pop,
+	* see vector_get_latency(). VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+	*/
+	bool latency;
+
+	/*
+	* A push that finds the producer lock taken while the vector is EMPTY offers its element
+	* to concurrent pops for a moment, and goes to the ring only if none takes it.
+	* A pop that finds the vector EMPTY watches for such offers for a moment before it waits.
+	* VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only, not with 'latency'.
+	*/
+	bool elimination;
+
+	/*
+	* Keep an eventfd that turns readable when the vector goes from EMPTY to not EMPTY, see vector_get_fd().
+	* VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+	*/
+	bool readiness_fd;
+} vector_attr_t;
+
+/*
+* A cell of the vector handed out by vector_reserve() or vector_peek_claim().
+* `element` points to the vector's element size of bytes, `internal` belongs to the vector.
+*/
+typedef struct vector_slot_t
+{
+	void* element;
+	void* internal;
+} vector_slot_t;
+
+/*
+* Vector statistics, see vector_stats().
+* Counters are totals since creation, or since the last vector_stats_reset().
+*/
+typedef struct vector_stats_t
+{
+	size_t depth;				// elements in the vector now
+	size_t high_watermark;		// largest depth ever, VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only
+	size_t capacity;			// VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only
+
+	size_t pushes;
+	size_t pops;
+	size_t expansions;			// chunks linked into the ring, by growth or vector_presize()
+	size_t bytes_allocated;		// chunk memory not reused from a pool
+	size_t lock_contended;		// lock acquisitions that found the lock taken, eliminated pushes included
+	size_t waits;				// consumers that went to sleep on an EMPTY vector
+	size_t eliminated;			// pushes handed straight to a pop, see vector_attr_t 'elimination'
+} vector_stats_t;
+
+/*
+* Push-to-pop latency of a vector in latency mode, see vector_get_latency().
+* Percentiles are rounded up by at most 1/16 of their value.
+*/
+typedef struct vector_latency_t
+{
+	uint64_t count;				// popped elements
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	uint64_t p999_ns;
+	uint64_t max_ns;			// exact
+} vector_latency_t;
+
 /**
  * Create a circular vector with `capacity` elements at most.
  *
@@ -24,6 +174,31 @@ typedef enum vector_ret_t
  */
 vector_t* vector_create(size_t capacity);
 
+/**
+ * Create a vector that stores elements of `element_size` bytes in place, see vector_attr_t.
+ * Use vector_push_copy() and vector_pop_copy() with it.
+ *
+ * RETURN VALUES:
+ * vector_t pointer
+ * NULL pointer -- when failed to allocate memory
+ *
+ * [in] - capacity, element_size
+ */
+vector_t* vector_create_sized(size_t capacity, size_t element_size);
+
+/**
+ * Create a vector with `capacity` elements at most, using the given attributes.
+ * With VECTOR_MODE_LOCKFREE `capacity` is the number of slots per segment,
+ * with VECTOR_MODE_SPSC the size of the first segment.
+ *
+ * RETURN VALUES:
+ * vector_t pointer
+ * NULL pointer -- when failed to allocate memory or attributes are invalid
+ *
+ * [in] - capacity, attr (NULL for defaults)
+ */
+vector_t* vector_create_attr(size_t capacity, const vector_attr_t* attr);
+
 /**
  * Destroy the vector.
  *
@@ -40,12 +215,24 @@ vector_ret_t vector_destroy(vector_t* vector);
  *
  * RETURN VALUES:
  * VECTOR_SUCCESS
- * VECTOR_FAILURE -- vector or element is invalid, or malloc failed when enlarging vector
+ * VECTOR_FAILURE -- vector or element is invalid, vector holds other than pointers,
+ *                   or malloc failed when enlarging vector
  *
  * [in] - vector, element
  */
 vector_ret_t vector_push(vector_t* vector, void* element);
 
+/**
+ * Copy an element of the vector's element size into the vector.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_element is invalid, or malloc failed when enlarging vector
+ *
+ * [in] - vector, p_element
+ */
+vector_ret_t vector_push_copy(vector_t* vector, const void* p_element);
+
 /**
  * Remove an element from the vector.
  * Block the thread, when vector is empty, waiting for new data.
@@ -59,5 +246,267 @@ vector_ret_t vector_push(vector_t* vector, void* element);
  */
 vector_ret_t vector_pop(vector_t* vector, void** p_element);
 
+/**
+ * Remove an element from the vector if there is one. Never blocks.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_EMPTY -- vector is empty, p_element is untouched
+ * VECTOR_FAILURE -- vector or p_element is invalid
+ *
+ * [in] - vector
+ * [out] - p_element
+ */
+vector_ret_t vector_try_pop(vector_t* vector, void** p_element);
+
+/**
+ * Remove an element from the vector.
+ * Block the thread, when vector is empty, until new data arrives or `deadline` passes.
+ * `deadline` is an absolute CLOCK_MONOTONIC time.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_TIMEOUT -- deadline passed while vector was empty, p_element is untouched
+ * VECTOR_FAILURE -- vector, p_element or deadline is invalid
+ *
+ * [in] - vector, deadline
+ * [out] - p_element
+ */
+vector_ret_t vector_pop_until(vector_t* vector, void** p_element, const struct timespec* deadline);
+
+/**
+ * Remove an element from the vector, copying the vector's element size into `p_element`.
+ * Block the thread, when vector is empty, waiting for new data.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_element is invalid
+ *
+ * [in] - vector
+ * [out] - p_element
+ */
+vector_ret_t vector_pop_copy(vector_t* vector, void* p_element);
+
+/**
+ * Same as vector_pop_copy(), but never blocks.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_EMPTY -- vector is empty, p_element is untouched
+ * VECTOR_FAILURE -- vector or p_element is invalid
+ *
+ * [in] - vector
+ * [out] - p_element
+ */
+vector_ret_t vector_try_pop_copy(vector_t* vector, void* p_element);
+
+/**
+ * Grow the vector to hold at least `capacity` elements, e.g. a high-watermark
+ * recorded earlier, and never shrink it below that. Memory is allocated
+ * without holding the vector lock. VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector is invalid or of another mode, or malloc failed
+ *
+ * [in] - vector, capacity
+ */
+vector_ret_t vector_presize(vector_t* vector, size_t capacity);
+
+/**
+ * Get the number of elements the vector holds without growing. VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_capacity is invalid, or of another mode
+ *
+ * [in] - vector
+ * [out] - p_capacity
+ */
+vector_ret_t vector_get_capacity(vector_t* vector, size_t* p_capacity);
+
+/**
+ * Get the largest number of elements the vector ever held at once. VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_high_watermark is invalid, or of another mode
+ *
+ * [in] - vector
+ * [out] - p_high_watermark
+ */
+vector_ret_t vector_get_high_watermark(vector_t* vector, size_t* p_high_watermark);
+
+/**
+ * Get the number of chunks the vector allocated so far, not counting the ones reused from its pool.
+ * It stays the same while a vector with a pool grows back to a size it had before.
+ * VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_allocations is invalid, or of another mode
+ *
+ * [in] - vector
+ * [out] - p_allocations
+ */
+vector_ret_t vector_get_allocations(vector_t* vector, size_t* p_allocations);
+
+/**
+ * Get percentiles of the time elements spent in the vector, from the push
+ * (vector_commit() for reserved slots) to the pop (vector_peek_claim() for claimed ones).
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_latency is invalid, or vector is not in latency mode
+ *
+ * [in] - vector
+ * [out] - p_latency
+ */
+vector_ret_t vector_get_latency(vector_t* vector, vector_latency_t* p_latency);
+
+/**
+ * Get the readiness eventfd of a vector created with 'readiness_fd', to wait on with poll() or epoll.
+ * Once it is readable, pop with vector_try_pop() or vector_try_pop_copy() until VECTOR_EMPTY:
+ * the pop that finds the vector EMPTY clears the fd. Pushes in between write to it once, not once per element.
+ * The fd belongs to the vector, do not read or close it.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_fd is invalid, or the vector has no readiness fd
+ *
+ * [in] - vector
+ * [out] - p_fd
+ */
+vector_ret_t vector_get_fd(vector_t* vector, int* p_fd);
+
+/**
+ * Get the vector statistics. Counters are kept per thread group, so taking
+ * a snapshot costs a little but updating them costs a few nanoseconds.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_stats is invalid, or statistics are compiled out
+ *
+ * [in] - vector
+ * [out] - p_stats
+ */
+vector_ret_t vector_stats(vector_t* vector, vector_stats_t* p_stats);
+
+/**
+ * Same as vector_stats(), then restart the counters from zero,
+ * so periodic calls return the deltas between them.
+ *
+ * [in] - vector
+ * [out] - p_stats
+ */
+vector_ret_t vector_stats_reset(vector_t* vector, vector_stats_t* p_stats);
+
+/**
+ * Add `n` elements to the vector under a single lock acquisition.
+ * Elements keep their order. Wakes up to `n` blocked consumers.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or elements is invalid, or malloc failed when enlarging vector
+ *
+ * [in] - vector, elements, n
+ */
+vector_ret_t vector_push_n(vector_t* vector, void* const* elements, size_t n);
+
+/**
+ * Same as vector_push_n(), `elements` holds `n` elements of the vector's element size back to back.
+ *
+ * [in] - vector, elements, n
+ */
+vector_ret_t vector_push_n_copy(vector_t* vector, const void* elements, size_t n);
+
+/**
+ * Remove up to `max` elements from the vector under a single lock acquisition.
+ * Block the thread, when vector is empty, waiting for new data.
+ * Returns as soon as at least one element is removed, so `*p_popped` may be less than `max`.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector, elements or p_popped is invalid
+ *
+ * [in] - vector, max
+ * [out] - elements, p_popped
+ */
+vector_ret_t vector_pop_n(vector_t* vector, void** elements, size_t max, size_t* p_popped);
+
+/**
+ * Same as vector_pop_n(), `elements` has room for `max` elements of the vector's element size.
+ *
+ * [in] - vector, max
+ * [out] - elements, p_popped
+ */
+vector_ret_t vector_pop_n_copy(vector_t* vector, void* elements, size_t max, size_t* p_popped);
+
+/**
+ * Reserve a cell at the tail of the vector for the caller to write in place.
+ * The element becomes visible to consumers on vector_commit(). Consumers that
+ * reach an uncommitted cell skip it, so a slow writer never holds up elements
+ * pushed after it; such an element is popped as soon as it is committed.
+ * VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_slot is invalid, or of another mode, or malloc failed
+ *
+ * [in] - vector
+ * [out] - p_slot
+ */
+vector_ret_t vector_reserve(vector_t* vector, vector_slot_t* p_slot);
+
+/**
+ * Publish an element written into a slot from vector_reserve(). Wakes one blocked consumer.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or slot is invalid, or slot was committed already
+ *
+ * [in] - vector, slot
+ */
+vector_ret_t vector_commit(vector_t* vector, vector_slot_t* slot);
+
+/**
+ * Remove an element from the vector without copying it out.
+ * Block the thread, when vector is empty, waiting for new data.
+ * The element stays readable in place until vector_release().
+ * VECTOR_MODE_LOCKED and VECTOR_MODE_TWO_LOCK only.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or p_slot is invalid, or of another mode
+ *
+ * [in] - vector
+ * [out] - p_slot
+ */
+vector_ret_t vector_peek_claim(vector_t* vector, vector_slot_t* p_slot);
+
+/**
+ * Same as vector_peek_claim(), but return at once when the vector is empty.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_EMPTY -- nothing to claim
+ * VECTOR_FAILURE -- vector or p_slot is invalid, or of another mode
+ *
+ * [in] - vector
+ * [out] - p_slot
+ */
+vector_ret_t vector_try_peek_claim(vector_t* vector, vector_slot_t* p_slot);
+
+/**
+ * Give back a cell claimed by vector_peek_claim(), so the vector may reuse its memory.
+ *
+ * RETURN VALUES:
+ * VECTOR_SUCCESS
+ * VECTOR_FAILURE -- vector or slot is invalid, or slot was released already
+ *
+ * [in] - vector, slot
+ */
+vector_ret_t vector_release(vector_t* vector, vector_slot_t* slot);
+
 #endif // VECTOR_H
 